@@ -175,6 +175,14 @@ build_directory() {
     ensure_out_dir
     cp -f "${BUILT_BIN}" "${OUT_FILE}"
     chmod +x "${OUT_FILE}"
+
+    # The resident daemon and the trace tool are built by the same Makefile; ship them next to ptzctl.
+    for extra in ptzd ptztrace; do
+        if [ -x "$(dirname -- "${BUILT_BIN}")/${extra}" ]; then
+            cp -f "$(dirname -- "${BUILT_BIN}")/${extra}" "$(dirname -- "${OUT_FILE}")/${extra}"
+            chmod +x "$(dirname -- "${OUT_FILE}")/${extra}"
+        fi
+    done
 }
 
 build_directory
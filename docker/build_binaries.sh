@@ -29,9 +29,13 @@ docker exec "${CID}" /work/build_ptzctl.sh
 
 echo "Copying build artifacts back"
 docker cp "${CID}:/work/dist/ptzctl" "${ROOT_DIR}/sd_card/custom/bin/ptzctl"
+docker cp "${CID}:/work/dist/ptzd" "${ROOT_DIR}/sd_card/custom/bin/ptzd"
+docker cp "${CID}:/work/dist/ptztrace" "${ROOT_DIR}/sd_card/custom/bin/ptztrace"
 
 echo "Done. Artifacts:"
 file "${ROOT_DIR}/sd_card/custom/bin/ptzctl"
+file "${ROOT_DIR}/sd_card/custom/bin/ptzd"
+file "${ROOT_DIR}/sd_card/custom/bin/ptztrace"
 
 docker stop "${CID}"
 docker rm "${CID}"
\ No newline at end of file
@@ -0,0 +1,680 @@
+#define _XOPEN_SOURCE 700
+#include "ptz_config_keys.h"
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* bench_ptz: motion/latency benchmarks against the simulated motor backend (MOTOR_BACKEND=3).
+
+   Usage: bench_ptz [--ptzctl ./ptzctl] [-o results.json]
+
+   Everything runs in a throwaway STATE_DIR; no hardware and no running ptzd are needed.
+   Results are one JSON object so runs can be diffed across commits. */
+
+#define SAMPLES_MAX 100000
+
+static char g_dir[64];
+static char g_conf[80];
+static FILE *g_out;
+static bool g_first_result = true;
+static bool g_check_failed; /* a regression check below went wrong: exit 1 */
+
+static double now_us(void) {
+    struct timespec ts;
+    (void)ptz_now_monotonic(&ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void result_begin(const char *name, const char *unit) {
+    fprintf(g_out, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\"", g_first_result ? "" : ",", name, unit);
+    g_first_result = false;
+}
+
+static void result_end(void) { fputs("}", g_out); }
+
+/* Emit mean/min/p50/p95/max for n samples (sorts them). */
+static void report_samples(const char *name, const char *unit, double *s, int n) {
+    result_begin(name, unit);
+    if (n <= 0) {
+        fputs(", \"skipped\": true", g_out);
+        result_end();
+        return;
+    }
+
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += s[i];
+    qsort(s, (size_t)n, sizeof(*s), cmp_double);
+
+    fprintf(g_out, ", \"n\": %d, \"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"max\": %.3f",
+            n, sum / n, s[0], s[n / 2], s[(n * 95) / 100], s[n - 1]);
+    result_end();
+}
+
+static void bench_config(ptz_config_t *cfg) {
+    ptz_config_init_defaults(cfg);
+    cfg->motor_backend = PTZ_MOTOR_BACKEND_SIM;
+    cfg->ioctl_get_state = PTZ_MOTOR_GET_STATE_IOR;
+    cfg->debug_log = 0;
+    cfg->continuous_mode = 0;
+    cfg->set_speed_each_move = 1; /* as shipped in ptz.conf: legacy moves run at *_SPEED_STEP */
+    cfg->pan_max_vel = 800; /* planner on, as suggested in ptz.conf */
+    cfg->pan_accel = 2400;
+    cfg->tilt_max_vel = 600;
+    cfg->tilt_accel = 1800;
+    snprintf(cfg->state_dir, sizeof(cfg->state_dir), "%s/state", g_dir);
+    snprintf(cfg->log_file, sizeof(cfg->log_file), "%s/ptz.log", g_dir);
+    snprintf(cfg->trace_file, sizeof(cfg->trace_file), "%s/trace.bin", g_dir);
+    snprintf(cfg->cmdq_file, sizeof(cfg->cmdq_file), "%s/cmdq.bin", g_dir);
+}
+
+/* Put both the stored position and the simulated head at (pan_deg, tilt_deg). */
+static void park(ptz_ctx_t *ctx, int pan_deg, int tilt_deg) {
+    (void)ptz_set_position(ctx, pan_deg, tilt_deg, 0);
+    ptz_sim_init(ctx);
+}
+
+static bool sim_running(ptz_ctx_t *ctx) {
+    struct ptz_motor_msg m[2];
+    for (int a = 0; a < 2; a++) {
+        if (ptz_sim_ioctl(ctx, (ptz_axis_t)a, ctx->cfg.ioctl_get_state, &m[a]) != 0) return false;
+    }
+    return (m[0].status | m[1].status) & PTZ_MOTOR_RUNNING;
+}
+
+static void bench_cli_cold(const char *ptzctl, double *s) {
+    int n = 0;
+    if (access(ptzctl, X_OK) == 0) {
+        for (int i = 0; i < 50; i++) {
+            double t0 = now_us();
+            pid_t pid = fork();
+            if (pid == 0) {
+                int devnull = open("/dev/null", O_WRONLY);
+                if (devnull >= 0) (void)dup2(devnull, STDOUT_FILENO);
+                execl(ptzctl, ptzctl, "--local", "-c", g_conf, "--get-position", (char *)NULL);
+                _exit(127);
+            }
+            if (pid < 0) break;
+
+            int status = 0;
+            (void)waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) break;
+            s[n++] = now_us() - t0;
+        }
+    }
+    report_samples("cli_cold_get_position", "us", s, n);
+}
+
+static void bench_move_dir(double *s) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+
+    /* One-shot mode: STEP_REPEAT ioctls per call. */
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    park(&ctx, cfg.pan_max_deg / 2, cfg.tilt_max_deg / 2);
+    int n = 0;
+    for (int i = 0; i < 20; i++) {
+        double t0 = now_us();
+        (void)ptz_move_dir(&ctx, (i & 1) ? "left" : "right", "0.5");
+        s[n++] = now_us() - t0;
+    }
+    ptz_ctx_close(&ctx);
+    report_samples("move_dir_oneshot", "us", s, n);
+
+    /* Continuous mode: the call only arms the axis. */
+    cfg.continuous_mode = 1;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    park(&ctx, cfg.pan_max_deg / 2, cfg.tilt_max_deg / 2);
+    n = 0;
+    for (int i = 0; i < 2000; i++) {
+        double t0 = now_us();
+        (void)ptz_move_dir(&ctx, (i & 1) ? "left" : "right", "0.5");
+        s[n++] = now_us() - t0;
+    }
+    report_samples("move_dir_arm", "us", s, n);
+
+    /* The same through the typed API: no direction or speed parsing. */
+    n = 0;
+    for (int i = 0; i < 2000; i++) {
+        double t0 = now_us();
+        (void)ptz_move(&ctx, (i & 1) ? PTZ_DIR_LEFT : PTZ_DIR_RIGHT, 0.5);
+        s[n++] = now_us() - t0;
+    }
+    (void)ptz_stop(&ctx);
+    ptz_ctx_close(&ctx);
+    report_samples("move_arm", "us", s, n);
+}
+
+/* One non-continuous move with a large STEP_MULT and STEP_REPEAT from the center: the stored position must follow
+   the simulated head (which, like ak_motor, takes each repeat as a new target), not step * rep into the end stop. */
+static void bench_move_repeat(void) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+    cfg.step_mult = 4;
+    cfg.step_repeat = 8;
+
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    ptz_vclock_t vc;
+    ptz_vclock_init(&vc, NULL);
+    ptz_ctx_set_clock(&ctx, &vc.clock);
+    park(&ctx, cfg.pan_max_deg / 2, cfg.tilt_max_deg / 2);
+
+    int p0 = 0, p1 = 0, t, z;
+    struct ptz_motor_msg m0, m1;
+    (void)ptz_get_position_steps(&ctx, &p0, &t, &z);
+    (void)ptz_sim_ioctl(&ctx, PTZ_AXIS_PAN, cfg.ioctl_get_state, &m0);
+    int rc = ptz_move(&ctx, PTZ_DIR_LEFT, 1.0);
+    while (rc == 0 && sim_running(&ctx)) ptz_vclock_advance_us(&vc, 1000);
+    (void)ptz_get_position_steps(&ctx, &p1, &t, &z);
+    (void)ptz_sim_ioctl(&ctx, PTZ_AXIS_PAN, cfg.ioctl_get_state, &m1);
+    int total = ctx.kin[PTZ_AXIS_PAN].total_steps;
+    ptz_ctx_close(&ctx);
+
+    int accounted = abs(p1 - p0), head = abs(m1.pos - m0.pos);
+    bool pinned = p1 <= 0 || p1 >= total;
+    if (rc != 0 || pinned) g_check_failed = true;
+
+    result_begin("move_dir_repeat", "steps");
+    fprintf(g_out, ", \"step_mult\": %d, \"step_repeat\": %d, \"rc\": %d, \"accounted\": %d, \"head\": %d, \"pinned\": %s",
+            cfg.step_mult, cfg.step_repeat, rc, accounted, head, pinned ? "true" : "false");
+    result_end();
+}
+
+static void bench_ticks(void) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+    cfg.continuous_mode = 1;
+    cfg.worker_interval_ms = 5;
+
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    park(&ctx, 0, cfg.tilt_max_deg / 2);
+    (void)ptz_move_dir(&ctx, "right", "0.5");
+
+    long ticks = 0, issued = 0;
+    double t0 = now_us(), t1 = t0;
+    while (t1 - t0 < 1e6) {
+        int rc = ptz_tick(&ctx);
+        if (rc < 0) break;
+        ticks++;
+        issued += rc;
+        t1 = now_us();
+    }
+    (void)ptz_stop(&ctx);
+    ptz_ctx_close(&ctx);
+
+    double secs = (t1 - t0) / 1e6;
+    result_begin("continuous_tick", "per_s");
+    fprintf(g_out, ", \"worker_interval_ms\": %d, \"ticks\": %.1f, \"motor_commands\": %.1f",
+            cfg.worker_interval_ms, ticks / secs, issued / secs);
+    result_end();
+}
+
+/* A joystick stream: cost of one in-place ptz_set_velocity() update, and motor ioctls per second of a held
+   velocity at full and at 10% speed (each tick issues one MOVE; SET_SPEED only on the first update). */
+static void bench_velocity(double *s) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    park(&ctx, cfg.pan_max_deg / 2, cfg.tilt_max_deg / 2);
+    (void)ptz_set_velocity(&ctx, 0.5, 0.0);
+    int n = 0;
+    for (int i = 0; i < 2000; i++) {
+        double t0 = now_us();
+        (void)ptz_set_velocity(&ctx, 0.49 + (i & 1) * 0.005, 0.0); /* same speed level */
+        s[n++] = now_us() - t0;
+    }
+    (void)ptz_stop(&ctx);
+    report_samples("velocity_update", "us", s, n);
+
+    const double speeds[2] = { 1.0, 0.1 };
+    for (int k = 0; k < 2; k++) {
+        park(&ctx, 0, cfg.tilt_max_deg / 2);
+        (void)ptz_set_velocity(&ctx, speeds[k], 0.0);
+
+        long issued = 0;
+        struct timespec due;
+        double t0 = now_us(), t1 = t0;
+        while (t1 - t0 < 2e6 && ptz_next_deadline(&ctx, &due) > 0) {
+            ptz_sleep_until(&due);
+            int rc = ptz_tick(&ctx);
+            if (rc < 0) break;
+            issued += rc;
+            t1 = now_us();
+        }
+        (void)ptz_stop(&ctx);
+
+        result_begin(k ? "velocity_hold_10pct" : "velocity_hold_full", "per_s");
+        fprintf(g_out, ", \"v\": %.2f, \"motor_commands\": %.1f", speeds[k], issued / ((t1 - t0) / 1e6));
+        result_end();
+    }
+    ptz_ctx_close(&ctx);
+}
+
+/* From (0, tilt_deg) to normalized (x, y): when the call returns and when the simulated head arrives. */
+static void move_abs_case(const char *name, ptz_config_t *cfg, int tilt_deg, double x, double y) {
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, cfg);
+    park(&ctx, 0, tilt_deg);
+
+    double t0 = now_us();
+    int rc = ptz_move_abs(&ctx, x, y, -1.0);
+    double t_ret = now_us();
+    while (rc == 0 && sim_running(&ctx)) ptz_sleep_us(1000);
+    double t_arr = now_us();
+    ptz_ctx_close(&ctx);
+
+    result_begin(name, "ms");
+    fprintf(g_out, ", \"planner\": %s, \"absrel_chunk_steps\": %d, \"absrel_interval_ms\": %d, \"rc\": %d"
+                   ", \"returned\": %.3f, \"time_to_target\": %.3f",
+            ptz_plan_enabled(cfg, PTZ_AXIS_PAN) ? "true" : "false",
+            cfg->absrel_chunk_steps, cfg->absrel_interval_ms, rc, (t_ret - t0) / 1e3, (t_arr - t0) / 1e3);
+    result_end();
+}
+
+/* Start a quarter pan, let ptz_tick() run it for run_ms, then ptz_stop(): how fast does the head halt? */
+static void move_abs_preempt_case(ptz_config_t *cfg, int run_ms) {
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, cfg);
+    park(&ctx, 0, cfg->tilt_max_deg / 2);
+
+    double t0 = now_us();
+    int rc = ptz_move_abs_start(&ctx, -0.5, 0.0, -1.0);
+    double t_ret = now_us();
+    while (rc == 0 && now_us() - t0 < run_ms * 1e3) {
+        (void)ptz_tick(&ctx);
+        ptz_sleep_us(1000);
+    }
+
+    double t_stop = now_us();
+    (void)ptz_stop(&ctx);
+    while (rc == 0 && sim_running(&ctx)) ptz_sleep_us(1000);
+    double t_halt = now_us();
+    ptz_ctx_close(&ctx);
+
+    result_begin("move_abs_preempt", "ms");
+    fprintf(g_out, ", \"planner\": %s, \"run_ms\": %d, \"rc\": %d, \"start_returned\": %.3f, \"stop_to_halt\": %.3f",
+            ptz_plan_enabled(cfg, PTZ_AXIS_PAN) ? "true" : "false", run_ms, rc,
+            (t_ret - t0) / 1e3, (t_halt - t_stop) / 1e3);
+    result_end();
+}
+
+static void bench_move_abs(void) {
+    static const int chunks[] = { 32, 64, 128 };
+    static const int intervals[] = { 0, 30 };
+
+    /* Quarter pan sweep (0 -> PAN_MAX_DEG/4), tilt unchanged. */
+    ptz_config_t cfg;
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        bench_config(&cfg);
+        cfg.absrel_interval_ms = intervals[i];
+        move_abs_case("move_abs_quarter_pan", &cfg, cfg.tilt_max_deg / 2, -0.5, 0.0);
+    }
+
+    /* Legacy fixed chunks (planner disabled). */
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+            bench_config(&cfg);
+            cfg.pan_max_vel = cfg.tilt_max_vel = 0;
+            cfg.absrel_chunk_steps = chunks[c];
+            cfg.absrel_interval_ms = intervals[i];
+            move_abs_case("move_abs_quarter_pan", &cfg, cfg.tilt_max_deg / 2, -0.5, 0.0);
+        }
+    }
+
+    /* Diagonal: quarter pan plus half tilt, planner (both axes together) vs legacy (one after the other). */
+    bench_config(&cfg);
+    move_abs_case("move_abs_diagonal", &cfg, 0, -0.5, 0.0);
+    cfg.pan_max_vel = cfg.tilt_max_vel = 0;
+    move_abs_case("move_abs_diagonal", &cfg, 0, -0.5, 0.0);
+
+    /* Stop in the middle of a tick-driven move. */
+    bench_config(&cfg);
+    move_abs_preempt_case(&cfg, 500);
+    cfg.pan_max_vel = cfg.tilt_max_vel = 0;
+    move_abs_preempt_case(&cfg, 500);
+}
+
+static void bench_log(double *s) {
+    for (int on = 0; on <= 1; on++) {
+        ptz_config_t cfg;
+        bench_config(&cfg);
+        cfg.debug_log = on;
+        cfg.log_level = PTZ_LOG_LVL_INFO;
+        cfg.log_max_kb = 0;
+
+        const int n = 20000;
+        double t0 = now_us();
+        for (int i = 0; i < n; i++) {
+            ptz_log_line(&cfg, "move dir=%s speed=%s pos=%d,%d,%d", "left", "0.5", i, 98, 0);
+        }
+        ptz_log_flush();
+        s[0] = (now_us() - t0) * 1e3 / n;
+
+        result_begin(on ? "log_line_debug_on" : "log_line_debug_off", "ns");
+        fprintf(g_out, ", \"n\": %d, \"mean\": %.1f", n, s[0]);
+        result_end();
+    }
+}
+
+static void bench_get_position(double *s) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+
+    const int n = 100000;
+    int x, y, z;
+    double t0 = now_us();
+    for (int i = 0; i < n; i++) (void)ptz_get_position(&ctx, &x, &y, &z);
+    s[0] = (now_us() - t0) * 1e3 / n;
+    ptz_ctx_close(&ctx);
+
+    result_begin("get_position", "ns");
+    fprintf(g_out, ", \"n\": %d, \"mean\": %.1f", n, s[0]);
+    result_end();
+}
+
+/* A 30 s held pan at half speed and a full-range abs move on a virtual clock (ptz_vclock_t), run twice: wall time
+   against simulated time, and whether both runs produced the same timeline. */
+static void bench_virtual(void) {
+    long issued[2] = { 0, 0 };
+    int end_pan[2] = { 0, 0 };
+    double abs_ms[2] = { 0, 0 }, wall_ms[2] = { 0, 0 };
+    const long hold_us = 30L * 1000000L;
+
+    for (int run = 0; run < 2; run++) {
+        ptz_config_t cfg;
+        bench_config(&cfg);
+        ptz_ctx_t ctx;
+        (void)ptz_ctx_init(&ctx, &cfg);
+        ptz_vclock_t vc;
+        ptz_vclock_init(&vc, NULL);
+        ptz_ctx_set_clock(&ctx, &vc.clock);
+        park(&ctx, 0, cfg.tilt_max_deg / 2);
+
+        double w0 = now_us();
+        (void)ptz_set_velocity(&ctx, 0.5, 0.0);
+        struct timespec due, stop_at = ptz_timespec_add_us(vc.now, hold_us);
+        while (ptz_next_deadline(&ctx, &due) > 0 && !ptz_timespec_ge(&due, &stop_at)) {
+            ptz_ctx_sleep_until(&ctx, &due);
+            int rc = ptz_tick(&ctx);
+            if (rc < 0) break;
+            issued[run] += rc;
+        }
+        (void)ptz_stop(&ctx);
+
+        struct ptz_motor_msg m;
+        if (ptz_sim_ioctl(&ctx, PTZ_AXIS_PAN, cfg.ioctl_get_state, &m) == 0) end_pan[run] = m.pos;
+
+        park(&ctx, 0, cfg.tilt_max_deg / 2);
+        struct timespec t0 = vc.now;
+        (void)ptz_move_abs(&ctx, 1.0, 0.0, -1.0);
+        while (sim_running(&ctx)) ptz_vclock_advance_us(&vc, 1000);
+        abs_ms[run] = (double)(vc.now.tv_sec - t0.tv_sec) * 1e3 + (double)(vc.now.tv_nsec - t0.tv_nsec) / 1e6;
+        wall_ms[run] = (now_us() - w0) / 1e3;
+        ptz_ctx_close(&ctx);
+    }
+
+    bool same = issued[0] == issued[1] && end_pan[0] == end_pan[1] && abs_ms[0] == abs_ms[1];
+    result_begin("virtual_clock", "ms");
+    fprintf(g_out, ", \"simulated\": %.1f, \"wall\": %.3f, \"speedup\": %.0f, \"hold_motor_commands\": %ld"
+                   ", \"hold_end_pan_steps\": %d, \"abs_full_pan_time_to_target\": %.1f, \"deterministic\": %s",
+            hold_us / 1e3 + abs_ms[0], wall_ms[0], (hold_us / 1e3 + abs_ms[0]) / wall_ms[0], issued[0], end_pan[0],
+            abs_ms[0], same ? "true" : "false");
+    result_end();
+}
+
+/* Simulated time of one tour cycle from `cycles` == c to c + 1. */
+static double tour_cycle_ms(ptz_ctx_t *ctx, ptz_vclock_t *vc) {
+    struct timespec due, t0 = { 0, 0 };
+    long seen = -1;
+    while (ctx->tour.active && ptz_next_deadline(ctx, &due) > 0) {
+        ptz_ctx_sleep_until(ctx, &due);
+        if (ptz_tick(ctx) < 0) break;
+        if (ctx->tour.cycles == seen) continue;
+        if (seen >= 0)
+            return (double)(vc->now.tv_sec - t0.tv_sec) * 1e3 + (double)(vc->now.tv_nsec - t0.tv_nsec) / 1e6;
+        seen = ctx->tour.cycles;
+        t0 = vc->now;
+    }
+    return -1.0;
+}
+
+/* An 8-stop patrol, 2 s dwell, on a virtual clock: planned and simulated cycle time in the given (zig-zag) order and
+   reordered, and the wall time a tour start (presets, cost matrix, ordering, leg planning) takes. */
+static void bench_tour(double *s) {
+    static const int pos[8][2] = { { 10, 20 }, { 300, 150 }, { 40, 120 }, { 330, 30 },
+                                   { 90, 60 }, { 250, 110 }, { 150, 170 }, { 200, 40 } };
+    ptz_config_t cfg;
+    bench_config(&cfg);
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    ptz_vclock_t vc;
+    ptz_vclock_init(&vc, NULL);
+    ptz_ctx_set_clock(&ctx, &vc.clock);
+
+    ptz_tour_spot_t spots[8];
+    for (int i = 0; i < 8; i++) {
+        (void)ptz_set_position(&ctx, pos[i][0], pos[i][1], 0);
+        spots[i].preset = ptz_preset_save(&ctx, 40 + i, "tour");
+        spots[i].dwell_ms = 2000;
+    }
+
+    double planned[2] = { 0, 0 }, cycle[2] = { 0, 0 };
+    for (int opt = 0; opt <= 1; opt++) {
+        park(&ctx, 180, 98);
+        (void)ptz_tour_start(&ctx, spots, 8, opt);
+        planned[opt] = (double)ctx.tour.cycle_ms;
+        (void)tour_cycle_ms(&ctx, &vc); /* the first cycle starts with the approach leg */
+        cycle[opt] = tour_cycle_ms(&ctx, &vc);
+        ptz_tour_stop(&ctx);
+    }
+
+    const int n = 200;
+    for (int i = 0; i < n; i++) {
+        double t0 = now_us();
+        (void)ptz_tour_start(&ctx, spots, 8, true);
+        s[i] = now_us() - t0;
+        ptz_tour_stop(&ctx);
+    }
+    ptz_ctx_close(&ctx);
+
+    result_begin("tour_8_stops", "ms");
+    fprintf(g_out, ", \"planned_given_order\": %.0f, \"simulated_given_order\": %.1f, \"planned_optimized\": %.0f"
+                   ", \"simulated_optimized\": %.1f",
+            planned[0], cycle[0], planned[1], cycle[1]);
+    result_end();
+    report_samples("tour_start", "us", s, n);
+}
+
+/* ptz_issue_motor() on a zero-latency simulated motor, without and with the trace ring. */
+static void bench_trace(double *s) {
+    for (int on = 0; on <= 1; on++) {
+        ptz_config_t cfg;
+        bench_config(&cfg);
+        cfg.sim_ioctl_latency_us = 0;
+        if (!on) cfg.trace_records = 0;
+
+        ptz_ctx_t ctx;
+        (void)ptz_ctx_init(&ctx, &cfg);
+        const int n = 100000;
+        double t0 = now_us();
+        for (int i = 0; i < n; i++) (void)ptz_issue_motor(&ctx, PTZ_AXIS_PAN, "", 1, 1, cfg.ioctl_stop, false);
+        s[0] = (now_us() - t0) * 1e3 / n;
+        ptz_ctx_close(&ctx);
+
+        result_begin(on ? "issue_motor_trace_on" : "issue_motor_trace_off", "ns");
+        fprintf(g_out, ", \"n\": %d, \"mean\": %.1f", n, s[0]);
+        result_end();
+    }
+}
+
+/* The command ring in one process: producer and consumer share the mapping, and the producer is handed the
+   consumer's eventfd directly instead of over PTZD_SOCKET. */
+static void bench_cmdq(double *s) {
+    ptz_config_t cfg;
+    bench_config(&cfg);
+    cfg.sim_ioctl_latency_us = 0;
+    ptz_ctx_t ctx;
+    (void)ptz_ctx_init(&ctx, &cfg);
+    int efd = ptz_cmdq_serve(&ctx);
+    ptz_cmdq_t q;
+    if (efd < 0 || ptz_cmdq_open(&q, &cfg) != 0) {
+        ptz_ctx_close(&ctx);
+        return;
+    }
+    if (q.doorbell < 0) q.doorbell = dup(efd);
+
+    /* Push cost alone: batches of 32 (half the ring), drained outside the timed part. */
+    const int n = 3200;
+    ptz_cmd_t c = { .op = PTZ_CMD_VELOCITY, .arg = 0, .v = { 0.5, 0, 0 } };
+    for (int i = 0; i < n; i += 32) {
+        double t0 = now_us();
+        for (int j = 0; j < 32; j++) (void)ptz_cmdq_push(&q, &c);
+        s[i / 32] = (now_us() - t0) * 1e3 / 32;
+        (void)ptz_cmdq_drain(&ctx);
+    }
+    report_samples("cmdq_push", "ns", s, n / 32);
+
+    /* A joystick burst: 60 velocity updates queued before ptzd gets to run, then a stop. */
+    const int burst = 60;
+    int applied = 0;
+    double drain_us = 0;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < burst; i++) {
+            c.op = PTZ_CMD_VELOCITY;
+            c.v[0] = 0.01 * (i + 1);
+            c.v[1] = -0.005 * i;
+            (void)ptz_cmdq_push(&q, &c);
+        }
+        double t0 = now_us();
+        applied += ptz_cmdq_drain(&ctx);
+        drain_us += now_us() - t0;
+        c.op = PTZ_CMD_STOP;
+        (void)ptz_cmdq_push(&q, &c);
+        (void)ptz_cmdq_drain(&ctx);
+    }
+    result_begin("cmdq_velocity_burst", "us");
+    fprintf(g_out, ", \"pushed\": %d, \"applied\": %d, \"drain_mean\": %.1f", burst, applied / 10, drain_us / 10);
+    result_end();
+
+    ptz_cmdq_close(&q);
+    ptz_ctx_close(&ctx);
+}
+
+/* ptz_config_load_file() on a config that sets every key: parsed each time (the snapshot cannot be
+   written under /dev/null) vs. served from STATE_DIR/ptz_config.cache. */
+static void bench_config_load(double *s) {
+    char path[96];
+    snprintf(path, sizeof(path), "%s/full.conf", g_dir);
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+#define W_STR(k, field, def) fprintf(f, "# %s\n%s=%s\n", k, k, def);
+#define W_HEX(k, field, def) fprintf(f, "# %s\n%s=0x%lx\n", k, k, (unsigned long)(def));
+#define W_INT(k, field, def) fprintf(f, "# %s\n%s=%d\n", k, k, (int)(def));
+    CFG_STR(W_STR)
+    CFG_HEX(W_HEX)
+    CFG_INT(W_INT)
+#undef W_STR
+#undef W_HEX
+#undef W_INT
+    fclose(f);
+
+    for (int cached = 0; cached <= 1; cached++) {
+        ptz_config_t base, cfg;
+        bench_config(&base);
+        if (!cached) snprintf(base.state_dir, sizeof(base.state_dir), "/dev/null/state");
+
+        const int n = 2000;
+        for (int i = 0; i < n; i++) {
+            cfg = base;
+            double t0 = now_us();
+            (void)ptz_config_load_file(&cfg, path);
+            s[i] = now_us() - t0;
+        }
+        report_samples(cached ? "config_load_cached" : "config_load_parse", "us", s, n);
+    }
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char *argv[]) {
+    const char *ptzctl = "./ptzctl";
+    const char *out_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ptzctl") == 0 && i + 1 < argc) ptzctl = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+    }
+
+    snprintf(g_dir, sizeof(g_dir), "/tmp/bench_ptz.XXXXXX");
+    if (!mkdtemp(g_dir)) {
+        fprintf(stderr, "bench_ptz: mkdtemp: %s\n", strerror(errno));
+        return 1;
+    }
+
+    ptz_config_t cfg;
+    bench_config(&cfg);
+    snprintf(g_conf, sizeof(g_conf), "%s/ptz.conf", g_dir);
+    FILE *f = fopen(g_conf, "w");
+    if (f) {
+        fprintf(f, "MOTOR_BACKEND=%d\nSTATE_DIR=%s\nLOG_FILE=%s\nTRACE_FILE=%s\nDEBUG_LOG=0\n",
+                cfg.motor_backend, cfg.state_dir, cfg.log_file, cfg.trace_file);
+        fclose(f);
+    }
+
+    g_out = out_path ? fopen(out_path, "w") : stdout;
+    if (!g_out) {
+        fprintf(stderr, "bench_ptz: %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+
+    double *samples = calloc(SAMPLES_MAX, sizeof(*samples));
+    if (!samples) return 1;
+
+    fprintf(g_out, "{\n  \"backend\": \"sim\", \"sim_step_rate\": %d, \"sim_ioctl_latency_us\": %d,\n  \"results\": [",
+            cfg.sim_step_rate, cfg.sim_ioctl_latency_us);
+
+    bench_cli_cold(ptzctl, samples);
+    bench_move_dir(samples);
+    bench_move_repeat();
+    bench_ticks();
+    bench_velocity(samples);
+    bench_move_abs();
+    bench_log(samples);
+    bench_get_position(samples);
+    bench_trace(samples);
+    bench_virtual();
+    bench_tour(samples);
+    bench_cmdq(samples);
+    bench_config_load(samples);
+
+    fputs("\n  ]\n}\n", g_out);
+    if (g_out != stdout) fclose(g_out);
+
+    free(samples);
+    (void)nftw(g_dir, rm_entry, 8, FTW_DEPTH | FTW_PHYS);
+    if (g_check_failed) fprintf(stderr, "bench_ptz: a regression check failed (see \"rc\"/\"pinned\" above)\n");
+    return g_check_failed ? 1 : 0;
+}
@@ -3,6 +3,7 @@
 #include "ptz_util.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 
@@ -15,86 +16,196 @@ static void parse_triple(const char *triple, double *x, double *y, double *z) {
     (void)sscanf(triple, "%lf,%lf,%lf", x, y, z);
 }
 
-int main(int argc, char *argv[]) {
-    ptz_config_t cfg;
-    ptz_config_init_defaults(&cfg);
+/* A single direction, or a diagonal such as up-left. */
+static bool is_dir_mode(const char *mode) { return ptz_dir_parse(mode) != PTZ_DIR_NONE; }
 
-    const char *conf_path = "/tmp/sd/custom/configs/ptz.conf";
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
-            conf_path = argv[++i];
-        }
+/* Forward one request to a resident ptzd. Returns 0 and sets *rc if the daemon answered. */
+static int run_via_daemon(const char *sock, const char *req, int *rc) {
+    static char reply[PTZ_IPC_REPLY_MAX];
+    if (ptz_ipc_request(sock, req, reply, sizeof(reply)) != 0) return -1;
+
+    const char *payload = "";
+    *rc = ptz_ipc_parse_reply(reply, &payload);
+    if (*rc < 0) *rc = 1; /* a failed request exits 1, as it does locally, not 255 */
+    fputs(payload, stdout);
+    return 0;
+}
+
+/* With the pure library, continuous movement only exists while this process runs: stay in the
+   foreground issuing ticks until interrupted or superseded, sleeping until each one is due. */
+static void run_foreground(ptz_ctx_t *ctx) {
+    signal(SIGINT, on_stop);
+    signal(SIGTERM, on_stop);
+    struct timespec due;
+    while (!g_stop) {
+        if (ptz_tick(ctx) < 0) break;
+        if (ptz_next_deadline(ctx, &due) <= 0) break;
+        ptz_ctx_sleep_until(ctx, &due);
     }
+    if (!ptz_motion_superseded(ctx)) (void)ptz_stop(ctx);
+}
 
-    /* Best-effort: if missing, keep defaults. */
-    (void)ptz_config_load_file(&cfg, conf_path);
+static int run_local(ptz_ctx_t *ctx, const char *mode, const char *speed,
+                     const char *triple, const char *preset, bool keep_order) {
+    if (strcmp(mode, "preset-save") == 0) {
+        int id = ptz_preset_save(ctx, 0, preset);
+        if (id < 0) return 1;
+        printf("%d\n", id);
+        return 0;
+    }
 
-    ptz_ctx_t ctx;
-    if (ptz_ctx_init(&ctx, &cfg) != 0) return 1;
+    if (strcmp(mode, "preset-del") == 0) return (ptz_preset_delete(ctx, ptz_parse_int(preset, -1)) == 0) ? 0 : 1;
+
+    if (strcmp(mode, "preset-list") == 0) {
+        char buf[PTZ_PRESET_MAX * 128]; /* a full line is under 80 bytes */
+        if (ptz_format_presets(ctx, buf, sizeof(buf)) != 0) return 1;
+        fputs(buf, stdout);
+        return 0;
+    }
 
-    if (argc >= 2 && strcmp(argv[1], "--get-position") == 0) {
+    if (strcmp(mode, "get-position") == 0) {
         int x, y, z;
-        (void)ptz_get_position(&ctx, &x, &y, &z);
+        (void)ptz_get_position(ctx, &x, &y, &z);
         printf("%d,%d,%d\n", x, y, z);
         return 0;
     }
 
-    if (argc >= 2 && strcmp(argv[1], "--is-moving") == 0) {
-        puts("0");
-        return 0;
+    /* The counters live in the process doing the moves; this one has none. */
+    if (strcmp(mode, "stats") == 0) {
+        fprintf(stderr, "ptzctl: --stats requires ptzd\n");
+        return 1;
     }
 
-    const char *mode = "";
-    const char *speed = "0.5";
-    const char *triple = NULL;
-    const char *preset = NULL;
+    if (strcmp(mode, "is-moving") == 0) {
+        printf("%d\n", (ptz_is_moving(ctx) > 0) ? 1 : 0);
+        return 0;
+    }
 
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) mode = argv[++i];
-        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) speed = argv[++i];
-        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) preset = argv[++i];
-        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) { mode = "abs"; triple = argv[++i]; }
-        else if (strcmp(argv[i], "-J") == 0 && i + 1 < argc) { mode = "rel"; triple = argv[++i]; }
-        else if (strcmp(argv[i], "-h") == 0) mode = "home";
+    if (is_dir_mode(mode)) {
+        int rc = ptz_move_dir(ctx, mode, speed);
+        if (rc != 0) return rc;
+        if (ctx->cfg.continuous_mode) run_foreground(ctx);
+        return 0;
     }
 
-    if (strcmp(mode, "left") == 0 || strcmp(mode, "right") == 0 ||
-        strcmp(mode, "up") == 0   || strcmp(mode, "down") == 0  ||
-        strcmp(mode, "in") == 0   || strcmp(mode, "out") == 0) {
-        int rc = ptz_move_dir(&ctx, mode, speed);
+    if (strcmp(mode, "velocity") == 0) {
+        double vx = 0.0, vy = 0.0;
+        if (triple) (void)sscanf(triple, "%lf,%lf", &vx, &vy);
+        int rc = ptz_set_velocity(ctx, vx, vy);
         if (rc != 0) return rc;
+        run_foreground(ctx);
+        return 0;
+    }
 
-        /* With the pure library, continuous movement only exists while this process runs.
-           If continuous_mode is enabled, stay in the foreground issuing periodic ticks until interrupted. */
-        if (cfg.continuous_mode) {
-            signal(SIGINT, on_stop);
-            signal(SIGTERM, on_stop);
-            while (!g_stop) {
-                int t = ptz_tick(&ctx);
-                if (t < 0) break;
-                ptz_sleep_us(5000);
-            }
-            (void)ptz_stop(&ctx);
-        }
+    if (strcmp(mode, "tour") == 0) {
+        ptz_tour_spot_t spots[PTZ_TOUR_MAX];
+        int n = ptz_tour_parse(triple, spots, PTZ_TOUR_MAX);
+        if (n <= 0) return 1;
+        int rc = ptz_tour_start(ctx, spots, n, !keep_order);
+        if (rc != 0) return rc;
+        run_foreground(ctx);
         return 0;
     }
 
-    if (strcmp(mode, "stop") == 0) return ptz_stop(&ctx);
-    if (strcmp(mode, "home") == 0) return ptz_home(&ctx);
+    /* Without ptzd a tour lives in the ptzctl that started it; taking the motion over ends it there. */
+    if (strcmp(mode, "stop") == 0 || strcmp(mode, "tour-stop") == 0) return ptz_stop(ctx);
+    if (strcmp(mode, "tour-status") == 0) {
+        fprintf(stderr, "ptzctl: --tour-status needs ptzd (a local tour is only known to the ptzctl running it)\n");
+        return 1;
+    }
+    if (strcmp(mode, "home") == 0) return ptz_home(ctx);
 
     if (strcmp(mode, "abs") == 0) {
         double x, y, z;
         parse_triple(triple, &x, &y, &z);
-        return ptz_move_abs(&ctx, x, y, z);
+        return ptz_move_abs(ctx, x, y, z);
     }
 
     if (strcmp(mode, "rel") == 0) {
         double dx, dy, dz;
         parse_triple(triple, &dx, &dy, &dz);
-        return ptz_move_rel(&ctx, dx, dy, dz);
+        return ptz_move_rel(ctx, dx, dy, dz);
     }
 
-    if (preset && *preset) return ptz_move_preset(&ctx, preset);
+    if (preset && *preset) return ptz_move_preset(ctx, preset);
 
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    const char *conf_path = "/tmp/sd/custom/configs/ptz.conf";
+    const char *sock_path = getenv("PTZD_SOCKET");
+    bool local_only = false;
+
+    const char *mode = "";
+    const char *speed = "0.5";
+    const char *triple = NULL;
+    const char *preset = NULL;
+
+    const char *query = NULL;
+    bool keep_order = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) conf_path = argv[++i];
+        else if (strcmp(argv[i], "--get-position") == 0) query = "get-position";
+        else if (strcmp(argv[i], "--is-moving") == 0) query = "is-moving";
+        else if (strcmp(argv[i], "--stats") == 0) query = "stats";
+        else if (strcmp(argv[i], "--preset-list") == 0) query = "preset-list";
+        else if (strcmp(argv[i], "--preset-save") == 0 && i + 1 < argc) { query = "preset-save"; preset = argv[++i]; }
+        else if (strcmp(argv[i], "--preset-del") == 0 && i + 1 < argc) { query = "preset-del"; preset = argv[++i]; }
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) sock_path = argv[++i];
+        else if (strcmp(argv[i], "--local") == 0) local_only = true;
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) mode = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) speed = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) preset = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) { mode = "abs"; triple = argv[++i]; }
+        else if (strcmp(argv[i], "-J") == 0 && i + 1 < argc) { mode = "rel"; triple = argv[++i]; }
+        else if (strcmp(argv[i], "-V") == 0 && i + 1 < argc) { mode = "velocity"; triple = argv[++i]; }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) { mode = "tour"; triple = argv[++i]; }
+        else if (strcmp(argv[i], "--tour-keep-order") == 0) keep_order = true;
+        else if (strcmp(argv[i], "--tour-stop") == 0) query = "tour-stop";
+        else if (strcmp(argv[i], "--tour-status") == 0) query = "tour-status";
+        else if (strcmp(argv[i], "-h") == 0) mode = "home";
+    }
+    if (query) mode = query;
+
+    /* Thin-client path: if ptzd is running, one socket round trip replaces config parsing,
+       context setup and motor open in this short-lived process. */
+    char req[256] = "";
+    if (is_dir_mode(mode)) snprintf(req, sizeof(req), "move %s %s", mode, speed);
+    else if (strcmp(mode, "abs") == 0 || strcmp(mode, "rel") == 0)
+        snprintf(req, sizeof(req), "%s %s", mode, triple ? triple : "0,0,0");
+    else if (strcmp(mode, "velocity") == 0)
+        snprintf(req, sizeof(req), "velocity %s", triple ? triple : "0,0");
+    else if (strcmp(mode, "tour") == 0)
+        snprintf(req, sizeof(req), "tour %s%s", triple ? triple : "", keep_order ? " keep" : "");
+    else if (strcmp(mode, "preset-save") == 0 || strcmp(mode, "preset-del") == 0)
+        snprintf(req, sizeof(req), "%s %s", mode, preset);
+    else if (strcmp(mode, "stop") == 0 || strcmp(mode, "home") == 0 || strcmp(mode, "preset-list") == 0 ||
+             strcmp(mode, "get-position") == 0 || strcmp(mode, "is-moving") == 0 || strcmp(mode, "stats") == 0 ||
+             strcmp(mode, "tour-stop") == 0 || strcmp(mode, "tour-status") == 0)
+        snprintf(req, sizeof(req), "%s", mode);
+    else if (preset && *preset) snprintf(req, sizeof(req), "preset %s", preset);
+
+    int rc = 0;
+    if (!local_only && req[0] &&
+        run_via_daemon(sock_path ? sock_path : PTZD_SOCKET_DEFAULT, req, &rc) == 0)
+        return rc;
+
+    ptz_config_t cfg;
+    ptz_config_init_defaults(&cfg);
+
+    /* Best-effort: if missing, keep defaults. */
+    (void)ptz_config_load_file(&cfg, conf_path);
+
+    if (!local_only && req[0] && !sock_path && strcmp(cfg.ptzd_socket, PTZD_SOCKET_DEFAULT) != 0 &&
+        run_via_daemon(cfg.ptzd_socket, req, &rc) == 0)
+        return rc;
+
+    ptz_ctx_t ctx;
+    if (ptz_ctx_init(&ctx, &cfg) != 0) return 1;
+
+    rc = run_local(&ctx, mode, speed, triple, preset, keep_order);
+    ptz_ctx_close(&ctx);
+    return rc;
+}
@@ -0,0 +1,64 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+/* Time source of a context.
+
+   Everything a context schedules (continuous ticks, abs/rel periods, STEP_REPEAT spacing, GET_STATE polling, the
+   simulated motors) reads and waits through ctx->clock. NULL is the real CLOCK_MONOTONIC. A virtual clock
+   (ptz_vclock_t) only moves when something sleeps on it, so a sleep returns at once and a 30 s patrol on the
+   simulated motors runs as fast as the CPU allows, with the same timeline on every run. Process-wide timing
+   (log flushing, the state seqlock's dead-writer timeout) stays on the real clock. */
+
+int ptz_ctx_now(const ptz_ctx_t *ctx, struct timespec *out) {
+    if (ctx && ctx->clock) return ctx->clock->now(ctx->clock->user, out);
+    return ptz_now_monotonic(out);
+}
+
+void ptz_ctx_sleep_until(const ptz_ctx_t *ctx, const struct timespec *deadline) {
+    if (ctx && ctx->clock) ctx->clock->sleep_until(ctx->clock->user, deadline);
+    else ptz_sleep_until(deadline);
+}
+
+void ptz_ctx_sleep_us(const ptz_ctx_t *ctx, long us) {
+    if (!ctx || !ctx->clock) {
+        ptz_sleep_us(us);
+        return;
+    }
+    struct timespec t;
+    if (ptz_ctx_now(ctx, &t) != 0) return;
+    t = ptz_timespec_add_us(t, us);
+    ptz_ctx_sleep_until(ctx, &t);
+}
+
+void ptz_ctx_set_clock(ptz_ctx_t *ctx, const ptz_clock_t *clock) {
+    if (!ctx) return;
+    ctx->clock = clock;
+    /* The simulated motors keep their segment start in clock time. */
+    ptz_sim_init(ctx);
+}
+
+static int vclock_now(void *user, struct timespec *out) {
+    const ptz_vclock_t *vc = user;
+    if (!out) return -1;
+    *out = vc->now;
+    return 0;
+}
+
+static void vclock_sleep_until(void *user, const struct timespec *deadline) {
+    ptz_vclock_t *vc = user;
+    if (deadline && !ptz_timespec_ge(&vc->now, deadline)) vc->now = *deadline;
+}
+
+void ptz_vclock_init(ptz_vclock_t *vc, const struct timespec *start) {
+    if (!vc) return;
+    vc->clock.now = vclock_now;
+    vc->clock.sleep_until = vclock_sleep_until;
+    vc->clock.user = vc;
+    /* Not the epoch: a zero deadline means "due at once" in places. */
+    vc->now.tv_sec = start ? start->tv_sec : 1000;
+    vc->now.tv_nsec = start ? start->tv_nsec : 0;
+}
+
+void ptz_vclock_advance_us(ptz_vclock_t *vc, long us) {
+    if (vc) vc->now = ptz_timespec_add_us(vc->now, us);
+}
@@ -0,0 +1,423 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Shared-memory command ring.
+
+   CMDQ_FILE (unset by default; e.g. /tmp/ptz_cmdq.bin, tmpfs) is a bounded multi-producer ring of 48-byte commands, mapped
+   MAP_SHARED by the consumer (ptzd) and by every producer. Each slot carries a sequence number: a producer claims
+   position p with a CAS on tail once the slot's seq says it is free (seq == p), writes the record and publishes
+   it with seq = p + 1; the consumer applies it and frees the slot for the next lap (seq = p + nslots). So a push
+   is a handful of atomics plus one eventfd write to wake the consumer; no lock, no socket round trip. The eventfd
+   cannot be opened by path, so ptzd hands it out over its control socket (SCM_RIGHTS) and producers fetch it
+   again whenever consumer_gen says a new consumer took over.
+
+   The consumer drains everything published so far in one go, so of consecutive velocity updates that piled up
+   only the last reaches the motors.
+
+   A producer that dies between claiming a slot and publishing it would block the ring, so once a slot has been
+   pending for CMDQ_STUCK_MS the consumer skips it. Skipping must never free a slot that a late producer can
+   still write into, since the next lap's producer may be filling it by then. So a producer takes the slot
+   (seq p -> p + 2, then its pid) before it writes anything, and the consumer only skips a slot nobody has taken
+   yet, which makes the late producer's take fail, or one whose writer has exited. A live producer that stalls
+   mid-write holds the ring up rather than corrupting it. */
+
+#define CMDQ_MAGIC     0x51444d43u /* "CMDQ" */
+#define CMDQ_VERSION   3u /* 2: PTZ_CMD_MOVE takes a ptz_dir_t; 3: writing/skipping states and the writer's pid */
+#define CMDQ_WRITING   2u /* seq offsets from the slot's position, see struct ptz_cmdq_rec */
+#define CMDQ_SKIPPING  3u
+#define CMDQ_SLOTS_MAX 4096u
+#define CMDQ_BATCH     32
+#define CMDQ_STUCK_MS  500
+
+_Static_assert(sizeof(struct ptz_cmdq_rec) == 48, "command record layout changed: bump CMDQ_VERSION");
+
+static size_t ring_size(uint32_t nslots) {
+    return sizeof(struct ptz_cmdq_shm) + (size_t)nslots * sizeof(struct ptz_cmdq_rec);
+}
+
+static uint32_t round_pow2(uint32_t n) {
+    uint32_t p = 8;
+    while (p < n && p < CMDQ_SLOTS_MAX) p <<= 1;
+    return p;
+}
+
+static bool header_ok(const struct ptz_cmdq_shm *h, size_t size) {
+    return atomic_load_explicit(&((struct ptz_cmdq_shm *)h)->magic, memory_order_acquire) == CMDQ_MAGIC &&
+           h->version == CMDQ_VERSION && h->nslots >= 8 && h->nslots <= CMDQ_SLOTS_MAX &&
+           !(h->nslots & (h->nslots - 1)) && size >= ring_size(h->nslots);
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    if (ptz_now_monotonic(&ts) != 0) return 0;
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Producer */
+
+static void fetch_doorbell(ptz_cmdq_t *q) {
+    if (q->doorbell >= 0) close(q->doorbell);
+    q->consumer_gen = atomic_load_explicit(&q->ring->consumer_gen, memory_order_acquire);
+    q->doorbell = ptz_ipc_request_fd(q->socket, "cmdq-doorbell");
+}
+
+int ptz_cmdq_open(ptz_cmdq_t *q, const ptz_config_t *cfg) {
+    if (!q || !cfg) return -1;
+    memset(q, 0, sizeof(*q));
+    q->doorbell = -1;
+    if (!cfg->cmdq_file[0] || cfg->cmdq_slots <= 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    /* The consumer creates the ring; without one nobody would apply the commands. */
+    int fd = open(cfg->cmdq_file, O_RDWR | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return -1;
+
+    struct stat sb;
+    struct ptz_cmdq_shm hdr;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(hdr) || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        !header_ok(&hdr, (size_t)sb.st_size)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = ring_size(hdr.nslots);
+    void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+
+    q->ring = (struct ptz_cmdq_shm *)m;
+    q->bytes = size;
+    snprintf(q->socket, sizeof(q->socket), "%s", cfg->ptzd_socket);
+    fetch_doorbell(q);
+    return 0;
+}
+
+void ptz_cmdq_close(ptz_cmdq_t *q) {
+    if (!q) return;
+    if (q->ring) (void)munmap(q->ring, q->bytes);
+    if (q->doorbell >= 0) close(q->doorbell);
+    q->ring = NULL;
+    q->bytes = 0;
+    q->doorbell = -1;
+}
+
+int ptz_cmdq_push(ptz_cmdq_t *q, const ptz_cmd_t *cmd) {
+    if (!q || !q->ring || !cmd) return -1;
+    struct ptz_cmdq_shm *r = q->ring;
+    uint32_t mask = r->nslots - 1u;
+
+    uint32_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    struct ptz_cmdq_rec *s;
+    for (;;) {
+        s = &r->slot[pos & mask];
+        int32_t dif = (int32_t)(atomic_load_explicit(&s->seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1u, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            /* The slot still holds the previous lap's command. */
+            atomic_fetch_add_explicit(&r->full, 1u, memory_order_relaxed);
+            errno = EAGAIN;
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+
+    /* Take the slot before writing to it. If we stalled long enough for the consumer to skip it, this fails
+       and the slot, possibly the next lap's by now, is left alone. */
+    int32_t self = (int32_t)getpid();
+    uint32_t expect = pos;
+    if (!atomic_compare_exchange_strong_explicit(&s->seq, &expect, pos + CMDQ_WRITING, memory_order_acquire,
+                                                 memory_order_relaxed)) {
+        errno = ETIMEDOUT; /* the consumer gave up on this slot */
+        return -1;
+    }
+    atomic_store_explicit(&s->pid, self, memory_order_relaxed);
+
+    s->op = (uint16_t)cmd->op;
+    s->reserved = 0;
+    s->arg = cmd->arg;
+    s->t_ns = now_ns();
+    memcpy(s->v, cmd->v, sizeof(s->v));
+    expect = pos + CMDQ_WRITING;
+    if (!atomic_compare_exchange_strong_explicit(&s->seq, &expect, pos + 1u, memory_order_release,
+                                                 memory_order_relaxed)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (atomic_load_explicit(&r->consumer_gen, memory_order_acquire) != q->consumer_gen || q->doorbell < 0)
+        fetch_doorbell(q);
+    if (q->doorbell >= 0) {
+        uint64_t one = 1;
+        ssize_t n = write(q->doorbell, &one, sizeof(one));
+        (void)n; /* the counter only saturates if the consumer is gone, and then nobody is listening */
+    }
+    return 0;
+}
+
+/* Consumer */
+
+void ptz_cmdq_close_consumer(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+    if (ctx->cmdq.ring) (void)munmap(ctx->cmdq.ring, ctx->cmdq.bytes);
+    if (ctx->cmdq.efd >= 0) close(ctx->cmdq.efd);
+    ctx->cmdq.ring = NULL;
+    ctx->cmdq.bytes = 0;
+    ctx->cmdq.efd = -1;
+}
+
+static void consumer_init(struct ptz_cmdq_shm *r, uint32_t nslots) {
+    atomic_store_explicit(&r->magic, 0, memory_order_relaxed);
+    r->version = CMDQ_VERSION;
+    r->nslots = nslots;
+    r->reserved = 0;
+    atomic_store_explicit(&r->consumer_gen, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->full, 0, memory_order_relaxed);
+    memset(r->slot, 0, (size_t)nslots * sizeof(r->slot[0]));
+    for (uint32_t i = 0; i < nslots; i++) atomic_store_explicit(&r->slot[i].seq, i, memory_order_relaxed);
+    atomic_store_explicit(&r->magic, CMDQ_MAGIC, memory_order_release);
+}
+
+/* Hand the slot at `pos` to the next lap. The consumer owns it (published, or skipping) until the seq store. */
+static void release_slot(struct ptz_cmdq_shm *r, struct ptz_cmdq_rec *s, uint32_t pos) {
+    atomic_store_explicit(&s->pid, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, pos + r->nslots, memory_order_release);
+}
+
+/* The slot's writer has exited (or has not stored its pid yet, a window of one store). */
+static bool writer_gone(const struct ptz_cmdq_rec *s) {
+    int32_t pid = atomic_load_explicit(&((struct ptz_cmdq_rec *)s)->pid, memory_order_relaxed);
+    return pid <= 0 || (kill((pid_t)pid, 0) != 0 && errno == ESRCH);
+}
+
+/* Give up on the claimed, unpublished slot at `pos` if nothing can write into it any more: nobody has taken it
+   (a late producer's take then fails) or its writer has exited. False while a live producer is writing it. */
+static bool skip_slot(struct ptz_cmdq_shm *r, struct ptz_cmdq_rec *s, uint32_t pos) {
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    if (seq != pos && (seq != pos + CMDQ_WRITING || !writer_gone(s))) return false;
+    if (!atomic_compare_exchange_strong_explicit(&s->seq, &seq, pos + CMDQ_SKIPPING, memory_order_acq_rel,
+                                                 memory_order_relaxed))
+        return false;
+    release_slot(r, s, pos);
+    return true;
+}
+
+/* Free every slot between head and tail without applying it: a move queued for a consumer that is gone is stale.
+   Stops at a slot a live producer is still writing; that command and the ones behind it are fresh. */
+static uint32_t discard_backlog(struct ptz_cmdq_shm *r) {
+    uint32_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t n = 0;
+    for (; pos != tail; pos++) {
+        struct ptz_cmdq_rec *s = &r->slot[pos & (r->nslots - 1u)];
+        if (atomic_load_explicit(&s->seq, memory_order_acquire) == pos + 1u) {
+            release_slot(r, s, pos);
+            n++;
+        } else if (!skip_slot(r, s, pos)) {
+            break;
+        }
+    }
+    atomic_store_explicit(&r->head, pos, memory_order_release);
+    return n;
+}
+
+int ptz_cmdq_serve(ptz_ctx_t *ctx) {
+    if (!ctx) return -1;
+    ptz_cmdq_close_consumer(ctx);
+
+    const ptz_config_t *cfg = &ctx->cfg;
+    if (!cfg->cmdq_file[0] || cfg->cmdq_slots <= 0) return -1;
+
+    /* Like TRACE_FILE, usually in /tmp: no symlinks, and only the owner may push. */
+    int fd = open(cfg->cmdq_file, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+    if (fd < 0) {
+        ptz_log_line(cfg, "cmdq %s: %s", cfg->cmdq_file, strerror(errno));
+        return -1;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* As with the trace ring: producers may have an intact ring mapped, so it keeps its size. */
+    uint32_t nslots = round_pow2((uint32_t)cfg->cmdq_slots);
+    bool existing = false;
+    struct ptz_cmdq_shm hdr;
+    if ((size_t)sb.st_size >= sizeof(hdr) && pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+        header_ok(&hdr, (size_t)sb.st_size)) {
+        if (hdr.nslots != nslots)
+            ptz_log_line(cfg, "cmdq %s keeps %u slots (CMDQ_SLOTS=%d); delete it to resize", cfg->cmdq_file,
+                         hdr.nslots, cfg->cmdq_slots);
+        nslots = hdr.nslots;
+        existing = true;
+    }
+
+    size_t size = ring_size(nslots);
+    if (!existing && (size_t)sb.st_size < size && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0) {
+        (void)munmap(m, size);
+        return -1;
+    }
+
+    struct ptz_cmdq_shm *r = (struct ptz_cmdq_shm *)m;
+    uint32_t stale = 0;
+    if (existing) stale = discard_backlog(r);
+    else consumer_init(r, nslots);
+    atomic_fetch_add_explicit(&r->consumer_gen, 1u, memory_order_release);
+
+    ctx->cmdq.ring = r;
+    ctx->cmdq.bytes = size;
+    ctx->cmdq.efd = efd;
+    ctx->cmdq.full_seen = atomic_load_explicit(&r->full, memory_order_relaxed);
+    ctx->cmdq.stuck_since = (struct timespec){ 0, 0 };
+    ptz_log_line(cfg, "cmdq %s: %u slots%s, %u stale commands discarded", cfg->cmdq_file, nslots,
+                 existing ? " (reused)" : "", stale);
+    return efd;
+}
+
+/* Whether the slot at `pos`, claimed but not published, has been pending for CMDQ_STUCK_MS. Only checked when
+   the doorbell rings, so a dead producer's slot is skipped on the first push after that. */
+static bool stuck_long(ptz_ctx_t *ctx, uint32_t pos) {
+    struct timespec now;
+    if (ptz_now_monotonic(&now) != 0) return false;
+    if (ctx->cmdq.stuck_pos != pos || (!ctx->cmdq.stuck_since.tv_sec && !ctx->cmdq.stuck_since.tv_nsec)) {
+        ctx->cmdq.stuck_pos = pos;
+        ctx->cmdq.stuck_since = now;
+        return false;
+    }
+    struct timespec due = ptz_timespec_add_us(ctx->cmdq.stuck_since, CMDQ_STUCK_MS * 1000L);
+    return ptz_timespec_ge(&now, &due);
+}
+
+/* Copy out up to `max` published commands, starting at head, and free their slots. */
+static int take(ptz_ctx_t *ctx, ptz_cmd_t *out, int64_t *t_ns, int max) {
+    struct ptz_cmdq_shm *r = ctx->cmdq.ring;
+    uint32_t mask = r->nslots - 1u;
+    uint32_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    int n = 0;
+
+    while (n < max) {
+        struct ptz_cmdq_rec *s = &r->slot[pos & mask];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq == pos + 1u) {
+            out[n].op = (ptz_cmd_op_t)s->op;
+            out[n].arg = s->arg;
+            memcpy(out[n].v, s->v, sizeof(out[n].v));
+            t_ns[n++] = s->t_ns;
+            release_slot(r, s, pos);
+            ctx->cmdq.stuck_since = (struct timespec){ 0, 0 };
+            pos++;
+            continue;
+        }
+        /* Nothing behind this slot yet, or its producer is still writing it. */
+        if ((seq != pos && seq != pos + CMDQ_WRITING) ||
+            (int32_t)(atomic_load_explicit(&r->tail, memory_order_acquire) - pos) <= 0 || !stuck_long(ctx, pos))
+            break;
+        if (!skip_slot(r, s, pos)) {
+            if (atomic_load_explicit(&s->seq, memory_order_acquire) == pos + 1u) continue; /* published meanwhile */
+            break; /* a live producer is still writing it */
+        }
+        ptz_log_line(&ctx->cfg, "cmdq: skipped slot %u, claimed but not published for %d ms", pos, CMDQ_STUCK_MS);
+        ctx->cmdq.stuck_since = (struct timespec){ 0, 0 };
+        pos++;
+    }
+
+    atomic_store_explicit(&r->head, pos, memory_order_release);
+    return n;
+}
+
+static int apply(ptz_ctx_t *ctx, const ptz_cmd_t *c) {
+    switch (c->op) {
+    case PTZ_CMD_STOP: return ptz_stop(ctx);
+    case PTZ_CMD_HOME: return ptz_home(ctx);
+    case PTZ_CMD_VELOCITY: return ptz_set_velocity(ctx, c->v[0], c->v[1]);
+    case PTZ_CMD_MOVE: return ptz_move(ctx, (ptz_dir_t)c->arg, (c->v[0] > 0) ? c->v[0] : PTZ_SPEED_DEFAULT);
+    case PTZ_CMD_ABS: return ptz_move_abs_start(ctx, c->v[0], c->v[1], c->v[2]);
+    case PTZ_CMD_REL: return ptz_move_rel_start(ctx, c->v[0], c->v[1], c->v[2]);
+    case PTZ_CMD_PRESET: return ptz_preset_goto_start(ctx, c->arg);
+    }
+    PTZ_LOGD(&ctx->cfg, "cmdq: unknown op %d", (int)c->op);
+    return -1;
+}
+
+static void apply_timed(ptz_ctx_t *ctx, const ptz_cmd_t *c, int64_t t_ns) {
+    int rc = apply(ctx, c);
+    PTZ_STAT(ptz_stats_cmdq(now_ns() - t_ns, false));
+    if (rc != 0) PTZ_LOGD(&ctx->cfg, "cmdq: op %d failed", (int)c->op);
+}
+
+int ptz_cmdq_drain(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->cmdq.ring) return 0;
+
+    uint64_t rung;
+    if (read(ctx->cmdq.efd, &rung, sizeof(rung)) < 0 && errno != EAGAIN) return 0;
+
+    /* A velocity update is held back until the next command: if that is another velocity update, the held one
+       is dropped. Everything else is applied in order. */
+    ptz_cmd_t batch[CMDQ_BATCH], held;
+    int64_t t_ns[CMDQ_BATCH], held_ns = 0;
+    bool holding = false;
+    int applied = 0, n;
+
+    do {
+        n = take(ctx, batch, t_ns, CMDQ_BATCH);
+        for (int i = 0; i < n; i++) {
+            if (holding && batch[i].op == PTZ_CMD_VELOCITY) {
+                PTZ_STAT(ptz_stats_cmdq(0, true));
+            } else if (holding) {
+                apply_timed(ctx, &held, held_ns);
+                applied++;
+            }
+            holding = false;
+            if (batch[i].op == PTZ_CMD_VELOCITY) {
+                held = batch[i];
+                held_ns = t_ns[i];
+                holding = true;
+            } else {
+                apply_timed(ctx, &batch[i], t_ns[i]);
+                applied++;
+            }
+        }
+    } while (n == CMDQ_BATCH);
+    if (holding) {
+        apply_timed(ctx, &held, held_ns);
+        applied++;
+    }
+
+    uint32_t full = atomic_load_explicit(&ctx->cmdq.ring->full, memory_order_relaxed);
+    if (full != ctx->cmdq.full_seen) {
+        ptz_log_line(&ctx->cfg, "cmdq: %u pushes refused, ring full (%u slots)", full - ctx->cmdq.full_seen,
+                     ctx->cmdq.ring->nslots);
+        ctx->cmdq.full_seen = full;
+    }
+    return applied;
+}
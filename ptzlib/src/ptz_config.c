@@ -1,60 +1,15 @@
 #define _POSIX_C_SOURCE 200809L
-#include "ptzctl.h"
-#include "ptz_util.h"
+#include "ptz_internal.h"
+#include "ptz_config_hash.h"
+#include "ptz_config_keys.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
-
-#define CFG_STR(X) \
-    X("ANYKA_PROC", anyka_proc, "anyka_ipc") \
-    X("STATE_DIR",  state_dir,  "/tmp/sd/custom/state") \
-    X("LOG_FILE",   log_file,   "/tmp/sd/logs/ptz.log") \
-    X("PAN_DEV",    pan_dev,    "/dev/motor0") \
-    X("TILT_DEV",   tilt_dev,   "/dev/motor1")
-
-#define CFG_HEX(X) \
-    X("PAN_FD_ADDR",       pan_fd_addr,       0x537760UL) \
-    X("TILT_FD_ADDR",      tilt_fd_addr,      0x5377d0UL) \
-    X("IOCTL_MOVE",        ioctl_move,        0x40046d40UL) \
-    X("IOCTL_STOP",        ioctl_stop,        0x40046d42UL) \
-    X("IOCTL_SET_SPEED",   ioctl_set_speed,   0x40046d20UL) \
-    X("IOCTL_GET_STATE",   ioctl_get_state,   0x40046d43UL) \
-    X("IOCTL_TURN_MIDDLE", ioctl_turn_middle, 0x40046d60UL)
-
-#define CFG_INT(X) \
-    X("ANYKA_PID",              anyka_pid,              0) \
-    X("MOTOR_BACKEND",          motor_backend,          0) \
-    X("PAN_MAX_DEG",            pan_max_deg,            360) \
-    X("PAN_TOTAL_STEPS",        pan_total_steps,        4096) \
-    X("TILT_MAX_DEG",           tilt_max_deg,           196) \
-    X("TILT_TOTAL_STEPS",       tilt_total_steps,       2230) \
-    X("PAN_INVERT",             pan_invert,             0) \
-    X("TILT_INVERT",            tilt_invert,            0) \
-    X("STEP_MULT",              step_mult,              4) \
-    X("STEP_REPEAT",            step_repeat,            8) \
-    X("PAN_STEP_MULT",          pan_step_mult,          -1) \
-    X("PAN_STEP_REPEAT",        pan_step_repeat,        -1) \
-    X("TILT_STEP_MULT",         tilt_step_mult,         -1) \
-    X("TILT_STEP_REPEAT",       tilt_step_repeat,       -1) \
-    X("TILT_STEP_ABS_MAX",      tilt_step_abs_max,      0) \
-    X("TILT_UP_STEP_MULT",      tilt_up_step_mult,      -1) \
-    X("TILT_UP_STEP_REPEAT",    tilt_up_step_repeat,    -1) \
-    X("TILT_UP_STEP_ABS_MAX",   tilt_up_step_abs_max,   0) \
-    X("TILT_DOWN_STEP_MULT",    tilt_down_step_mult,    -1) \
-    X("TILT_DOWN_STEP_REPEAT",  tilt_down_step_repeat,  -1) \
-    X("TILT_DOWN_STEP_ABS_MAX", tilt_down_step_abs_max, 0) \
-    X("PAN_SPEED_STEP",         pan_speed_step,         800) \
-    X("TILT_SPEED_STEP",        tilt_speed_step,        600) \
-    X("SET_SPEED_EACH_MOVE",    set_speed_each_move,    0) \
-    X("CONTINUOUS_MODE",        continuous_mode,        1) \
-    X("WORKER_INTERVAL_MS",     worker_interval_ms,     80) \
-    X("CONTINUOUS_STEP_DIV",    continuous_step_div,    8) \
-    X("CONTINUOUS_REP",         continuous_rep,         1) \
-    X("ABSREL_CHUNK_STEPS",     absrel_chunk_steps,     64) \
-    X("ABSREL_INTERVAL_MS",     absrel_interval_ms,     30) \
-    X("ZOOM_SUPPORTED",         zoom_supported,         0) \
-    X("DEBUG_LOG",              debug_log,              1)
+#include <sys/stat.h>
+#include <unistd.h>
 
 void ptz_config_init_defaults(ptz_config_t *cfg) {
     memset(cfg, 0, sizeof(*cfg));
@@ -94,31 +49,36 @@ static const cfg_entry_t CFG_MAP[] = {
 #undef MAP_INT
 };
 
+_Static_assert(sizeof(CFG_MAP) / sizeof(CFG_MAP[0]) == PTZ_CFG_NKEYS,
+               "ptz_config_hash.h is stale; rebuild it with `make src/ptz_config_hash.h`");
+
+/* Perfect hash from tools/gen_config_hash.c: one hash and one strcmp per line, unknown keys included. */
+static const cfg_entry_t *lookup_key(const char *k) {
+    uint32_t h = ptz_cfg_key_hash(k, PTZ_CFG_HASH_SEED) & ((1u << PTZ_CFG_HASH_BITS) - 1);
+    unsigned idx = PTZ_CFG_HASH_SLOT[h];
+    if (!idx) return NULL;
+    const cfg_entry_t *e = &CFG_MAP[idx - 1];
+    return (strcmp(k, e->key) == 0) ? e : NULL;
+}
+
 static void apply_kv(ptz_config_t *cfg, const char *k, const char *v) {
-    for (size_t i = 0; i < sizeof(CFG_MAP) / sizeof(CFG_MAP[0]); i++) {
-        const cfg_entry_t *e = &CFG_MAP[i];
-        if (strcmp(k, e->key) != 0) continue;
-
-        uint8_t *base = (uint8_t*)cfg + e->off;
-        if (e->t == T_INT) {
-            int *p = (int*)base;
-            *p = ptz_parse_int(v, *p);
-        } else if (e->t == T_HEX) {
-            unsigned long *p = (unsigned long*)base;
-            *p = ptz_parse_hex(v, *p);
-        } else {
-            char *p = (char*)base;
-            snprintf(p, e->sz, "%s", v ? v : "");
-        }
-        return;
+    const cfg_entry_t *e = lookup_key(k);
+    if (!e) return;
+
+    uint8_t *base = (uint8_t*)cfg + e->off;
+    if (e->t == T_INT) {
+        int *p = (int*)base;
+        *p = ptz_parse_int(v, *p);
+    } else if (e->t == T_HEX) {
+        unsigned long *p = (unsigned long*)base;
+        *p = ptz_parse_hex(v, *p);
+    } else {
+        char *p = (char*)base;
+        snprintf(p, e->sz, "%s", v ? v : "");
     }
 }
 
-int ptz_config_load_file(ptz_config_t *cfg, const char *path) {
-    if (!path || !*path) return -1;
-    FILE *f = fopen(path, "r");
-    if (!f) return -1;
-
+static void parse_file(ptz_config_t *cfg, FILE *f) {
     char line[512];
     while (fgets(line, sizeof(line), f)) {
         char *p = ptz_trim(line);
@@ -128,7 +88,168 @@ int ptz_config_load_file(ptz_config_t *cfg, const char *path) {
         *eq = '\0';
         apply_kv(cfg, ptz_trim(p), ptz_trim(eq + 1));
     }
+}
+
+/* Resolved-config snapshot: STATE_DIR/ptz_config.cache.
+
+   Every ptzctl invocation used to re-parse ptz.conf from the SD card. Instead, the resolved
+   ptz_config_t is stored along with the identity of the file it came from. It is reused while that
+   file's dev/inode, size, mtime and ctime are unchanged, so an unchanged config costs one stat and
+   one read. The snapshot also records the config it was applied on top of (normally the defaults),
+   the struct size and the key table signature, so a rebuilt binary or a different caller never picks
+   up a foreign snapshot. STATE_DIR is the one in `cfg` when loading starts, since that is the only
+   directory we know before reading the file. */
+
+#define CFG_CACHE_MAGIC   0x435a5450u /* "PTZC" */
+#define CFG_CACHE_VERSION 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cfg_size;
+    uint32_t keys_sig;
+    uint32_t base_sum; /* checksum of the config the file was applied to */
+    uint32_t reserved;
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    char path[256];
+    ptz_config_t cfg;
+    uint32_t sum; /* over everything above */
+} cfg_cache_t;
+
+static uint32_t bytes_sum(const void *p, size_t n) {
+    const uint8_t *b = (const uint8_t*)p;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Fill the header part of `c` for `path` as described by `st`. -1 if the path does not fit. */
+static int cache_header(cfg_cache_t *c, const char *path, const struct stat *st, const ptz_config_t *base) {
+    memset(c, 0, sizeof(*c));
+    c->magic = CFG_CACHE_MAGIC;
+    c->version = CFG_CACHE_VERSION;
+    c->cfg_size = (uint32_t)sizeof(ptz_config_t);
+    c->keys_sig = PTZ_CFG_KEYS_SIG;
+    c->base_sum = bytes_sum(base, sizeof(*base));
+    c->dev = (uint64_t)st->st_dev;
+    c->ino = (uint64_t)st->st_ino;
+    c->size = (int64_t)st->st_size;
+    c->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    c->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    c->ctime_sec = (int64_t)st->st_ctim.tv_sec;
+    c->ctime_nsec = (int64_t)st->st_ctim.tv_nsec;
+    int n = snprintf(c->path, sizeof(c->path), "%s", path);
+    return (n > 0 && (size_t)n < sizeof(c->path)) ? 0 : -1;
+}
+
+static int cache_load(const char *cache_path, const cfg_cache_t *want, ptz_config_t *out) {
+    int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    cfg_cache_t c;
+    ssize_t n = read(fd, &c, sizeof(c));
+    close(fd);
+
+    if (n != (ssize_t)sizeof(c)) return -1;
+    if (c.sum != bytes_sum(&c, offsetof(cfg_cache_t, sum))) return -1;
+    if (memcmp(&c, want, offsetof(cfg_cache_t, cfg)) != 0) return -1;
+    *out = c.cfg;
+    return 0;
+}
+
+static void cache_store(const char *cache_path, const char *state_dir, cfg_cache_t *c) {
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", cache_path, (long)getpid());
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        ptz_mkdir_p_for_file(cache_path);
+        (void)mkdir(state_dir, 0755);
+        fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) return;
+
+    c->sum = bytes_sum(c, offsetof(cfg_cache_t, sum));
+    bool ok = write(fd, c, sizeof(*c)) == (ssize_t)sizeof(*c);
+    if (close(fd) != 0) ok = false;
+    /* rename() so a concurrent ptzctl never reads half a snapshot. */
+    if (!ok || rename(tmp, cache_path) != 0) (void)unlink(tmp);
+}
+
+int ptz_config_load_file(ptz_config_t *cfg, const char *path) {
+    if (!path || !*path) return -1;
+
+    char cache_path[512];
+    int n = snprintf(cache_path, sizeof(cache_path), "%s/ptz_config.cache", cfg->state_dir);
+    bool use_cache = n > 0 && (size_t)n < sizeof(cache_path);
+
+    cfg_cache_t c;
+    struct stat st;
+    if (use_cache && stat(path, &st) == 0 && cache_header(&c, path, &st, cfg) == 0 &&
+        cache_load(cache_path, &c, cfg) == 0)
+        return 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    /* Key the snapshot on the file actually opened, in case it was replaced since the stat(). */
+    use_cache = use_cache && fstat(fileno(f), &st) == 0 && cache_header(&c, path, &st, cfg) == 0;
+    char state_dir[sizeof(cfg->state_dir)];
+    memcpy(state_dir, cfg->state_dir, sizeof(state_dir));
 
+    parse_file(cfg, f);
     fclose(f);
+
+    if (use_cache) {
+        c.cfg = *cfg;
+        cache_store(cache_path, state_dir, &c);
+    }
     return 0;
 }
+
+/* Only what the library cannot work around. Out-of-range tuning is clamped where it is used (intervals, STEP_MULT,
+   STEP_REPEAT), and 0 or negative planner limits, TRACE_RECORDS and CMDQ_SLOTS switch the feature off. */
+int ptz_config_validate(const ptz_config_t *cfg, char *why, size_t why_sz) {
+    const char *bad = NULL;
+    if (!cfg) bad = "no config";
+    else if (cfg->motor_backend < 0 || cfg->motor_backend > 3) bad = "MOTOR_BACKEND must be 0..3";
+    else if (cfg->pan_total_steps <= 0 || cfg->tilt_total_steps <= 0) bad = "*_TOTAL_STEPS must be > 0";
+    else if (cfg->pan_max_deg <= 0 || cfg->tilt_max_deg <= 0) bad = "*_MAX_DEG must be > 0";
+    else if (!cfg->ioctl_move || !cfg->ioctl_stop) bad = "IOCTL_MOVE and IOCTL_STOP must be set";
+    else if (!cfg->state_dir[0]) bad = "STATE_DIR is empty";
+
+    if (why && why_sz) snprintf(why, why_sz, "%s", bad ? bad : "");
+    return bad ? -1 : 0;
+}
+
+int ptz_config_diff(const ptz_config_t *a, const ptz_config_t *b, char *keys, size_t keys_sz) {
+    int n = 0;
+    size_t used = 0;
+    if (keys && keys_sz) keys[0] = '\0';
+
+    for (size_t i = 0; i < sizeof(CFG_MAP) / sizeof(CFG_MAP[0]); i++) {
+        const cfg_entry_t *e = &CFG_MAP[i];
+        const uint8_t *pa = (const uint8_t*)a + e->off;
+        const uint8_t *pb = (const uint8_t*)b + e->off;
+        bool same;
+        if (e->t == T_INT) same = *(const int*)pa == *(const int*)pb;
+        else if (e->t == T_HEX) same = *(const unsigned long*)pa == *(const unsigned long*)pb;
+        else same = strncmp((const char*)pa, (const char*)pb, e->sz) == 0;
+        if (same) continue;
+
+        if (keys && used < keys_sz) {
+            int w = snprintf(keys + used, keys_sz - used, "%s%s", n ? "," : "", e->key);
+            if (w > 0) used += (size_t)w;
+        }
+        n++;
+    }
+    return n;
+}
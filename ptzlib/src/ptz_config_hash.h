@@ -0,0 +1,24 @@
+/* Generated by tools/gen_config_hash.c from ptz_config_keys.h. Do not edit. */
+#ifndef PTZ_CONFIG_HASH_H
+#define PTZ_CONFIG_HASH_H
+
+#include <stdint.h>
+
+#define PTZ_CFG_NKEYS     59
+#define PTZ_CFG_KEYS_SIG  0x150544e1u
+#define PTZ_CFG_HASH_SEED 0x000903d8u
+#define PTZ_CFG_HASH_BITS 7
+
+/* slot -> key table index + 1; 0 = no key */
+static const uint8_t PTZ_CFG_HASH_SLOT[1u << PTZ_CFG_HASH_BITS] = {
+     55,  56,  58,  38,   0,   0,  28,  40,  43,   0,  27,   0,   0,   0,  25,   0,
+     39,   0,   0,  37,  18,  24,  52,   0,   0,  51,   0,   0,   0,  31,   8,   0,
+      0,  16,   0,  14,   6,  30,  44,  29,   0,  50,   0,   0,   0,   7,   0,  49,
+      0,   0,   0,   0,   0,  20,   1,  10,   0,   0,  47,   0,   0,  48,   0,   3,
+     21,   0,   0,  57,  42,   0,   0,   0,   0,   0,   0,   0,   0,  54,   0,   0,
+      4,   0,   0,  19,   0,   0,  46,  32,   0,   0,  11,   2,  59,   0,  34,   0,
+      0,   0,   0,  26,  33,   0,   0,  35,  17,   0,   0,  23,   0,   0,   0,  41,
+     13,  45,   0,   0,   0,   0,   0,  12,   5,  15,   0,  53,  36,  22,   9,   0,
+};
+
+#endif /* PTZ_CONFIG_HASH_H */
@@ -0,0 +1,90 @@
+#ifndef PTZ_CONFIG_KEYS_H
+#define PTZ_CONFIG_KEYS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ptz.conf keys: X(key, ptz_config_t field, default).
+
+   Shared by ptz_config.c and tools/gen_config_hash.c, which turns the key list into the perfect hash
+   in ptz_config_hash.h. Adding, removing or renaming a key regenerates that header (make does it). */
+
+#define CFG_STR(X) \
+    X("ANYKA_PROC",  anyka_proc,  "anyka_ipc") \
+    X("STATE_DIR",   state_dir,   "/tmp/sd/custom/state") \
+    X("LOG_FILE",    log_file,    "/tmp/sd/logs/ptz.log") \
+    X("PTZD_SOCKET", ptzd_socket, PTZD_SOCKET_DEFAULT) \
+    X("PAN_DEV",     pan_dev,     "/dev/motor0") \
+    X("TILT_DEV",    tilt_dev,    "/dev/motor1") \
+    X("TRACE_FILE",  trace_file,  "") \
+    X("CMDQ_FILE",   cmdq_file,   "")
+
+#define CFG_HEX(X) \
+    X("PAN_FD_ADDR",       pan_fd_addr,       0x537760UL) \
+    X("TILT_FD_ADDR",      tilt_fd_addr,      0x5377d0UL) \
+    X("IOCTL_MOVE",        ioctl_move,        0x40046d40UL) \
+    X("IOCTL_STOP",        ioctl_stop,        0x40046d42UL) \
+    X("IOCTL_SET_SPEED",   ioctl_set_speed,   0x40046d20UL) \
+    X("IOCTL_GET_STATE",   ioctl_get_state,   0UL) \
+    X("IOCTL_TURN_MIDDLE", ioctl_turn_middle, 0x40046d60UL)
+
+#define CFG_INT(X) \
+    X("ANYKA_PID",              anyka_pid,              0) \
+    X("MOTOR_BACKEND",          motor_backend,          0) \
+    X("PAN_MAX_DEG",            pan_max_deg,            360) \
+    X("PAN_TOTAL_STEPS",        pan_total_steps,        4096) \
+    X("TILT_MAX_DEG",           tilt_max_deg,           196) \
+    X("TILT_TOTAL_STEPS",       tilt_total_steps,       2230) \
+    X("PAN_INVERT",             pan_invert,             0) \
+    X("TILT_INVERT",            tilt_invert,            0) \
+    X("STEP_MULT",              step_mult,              4) \
+    X("STEP_REPEAT",            step_repeat,            8) \
+    X("PAN_STEP_MULT",          pan_step_mult,          -1) \
+    X("PAN_STEP_REPEAT",        pan_step_repeat,        -1) \
+    X("TILT_STEP_MULT",         tilt_step_mult,         -1) \
+    X("TILT_STEP_REPEAT",       tilt_step_repeat,       -1) \
+    X("TILT_STEP_ABS_MAX",      tilt_step_abs_max,      0) \
+    X("TILT_UP_STEP_MULT",      tilt_up_step_mult,      -1) \
+    X("TILT_UP_STEP_REPEAT",    tilt_up_step_repeat,    -1) \
+    X("TILT_UP_STEP_ABS_MAX",   tilt_up_step_abs_max,   0) \
+    X("TILT_DOWN_STEP_MULT",    tilt_down_step_mult,    -1) \
+    X("TILT_DOWN_STEP_REPEAT",  tilt_down_step_repeat,  -1) \
+    X("TILT_DOWN_STEP_ABS_MAX", tilt_down_step_abs_max, 0) \
+    X("PAN_SPEED_STEP",         pan_speed_step,         800) \
+    X("TILT_SPEED_STEP",        tilt_speed_step,        600) \
+    X("SET_SPEED_EACH_MOVE",    set_speed_each_move,    0) \
+    X("CONTINUOUS_MODE",        continuous_mode,        1) \
+    X("WORKER_INTERVAL_MS",     worker_interval_ms,     80) \
+    X("CONTINUOUS_STEP_DIV",    continuous_step_div,    8) \
+    X("CONTINUOUS_REP",         continuous_rep,         1) \
+    X("ABSREL_CHUNK_STEPS",     absrel_chunk_steps,     64) \
+    X("ABSREL_INTERVAL_MS",     absrel_interval_ms,     30) \
+    X("PAN_MAX_VEL",            pan_max_vel,            0) \
+    X("PAN_ACCEL",              pan_accel,              0) \
+    X("TILT_MAX_VEL",           tilt_max_vel,           0) \
+    X("TILT_ACCEL",             tilt_accel,             0) \
+    X("ZOOM_SUPPORTED",         zoom_supported,         0) \
+    X("DEBUG_LOG",              debug_log,              1) \
+    X("LOG_LEVEL",              log_level,              2) \
+    X("LOG_MAX_KB",             log_max_kb,             512) \
+    X("LOG_FLUSH_MS",           log_flush_ms,           1000) \
+    X("POSITION_TEXT_EXPORT",   position_text_export,   1) \
+    X("SIM_STEP_RATE",          sim_step_rate,          800) \
+    X("SIM_IOCTL_LATENCY_US",   sim_ioctl_latency_us,   150) \
+    X("TRACE_RECORDS",          trace_records,          4096) \
+    X("CMDQ_SLOTS",             cmdq_slots,             64)
+
+/* Order of the key table: strings, then hex, then ints. */
+#define PTZ_CFG_KEYS(X) CFG_STR(X) CFG_HEX(X) CFG_INT(X)
+
+/* FNV-1a with a seed, folded so the low bits mix in the high ones. Also used by the generator. */
+static inline uint32_t ptz_cfg_key_hash(const char *s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+#endif /* PTZ_CONFIG_KEYS_H */
@@ -2,34 +2,23 @@
 #include "ptz_internal.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /* ONVIF speed is typically 0..1. We treat it as a velocity factor. */
-static double parse_speed_factor(const char *s) {
-    double v = 0.5;
-    if (s && *s) v = atof(s);
-    if (v < 0) v = -v;
-
+static double speed_factor(double v) {
     if (v > 1.0) v = 1.0;
     if (v < 0.01) v = 0.01;
     return v;
 }
 
 /* This is still used to decide how many degrees/steps each command should represent. */
-static int speed_to_deg(const char *s) {
-    double v = 0.5;
-    if (s && *s) v = atof(s);
-    if (v < 0) v = -v;
+static int speed_to_deg(double v) {
     return ptz_clampi((int)(v * 20.0) + 2, 1, 25);
 }
 
-static int deg_to_steps(int deg, int total_steps, int max_deg) {
-    if (max_deg <= 0) return 1;
-    int s = (deg * total_steps) / max_deg;
-    return (s < 1) ? 1 : s;
-}
-
 static int clamp_abs_step(int step, int abs_max) {
     if (abs_max <= 0) return step;
     int a = (step < 0) ? -step : step;
@@ -37,55 +26,91 @@ static int clamp_abs_step(int step, int abs_max) {
     return (step < 0) ? -abs_max : abs_max;
 }
 
-static int apply_dir_polarity(const ptz_config_t *cfg, const char *dir, int step) {
-    bool pan = (strcmp(dir, "left") == 0 || strcmp(dir, "right") == 0);
-    bool tilt = (strcmp(dir, "up") == 0 || strcmp(dir, "down") == 0);
-
-    if (pan && cfg->pan_invert) step = -step;
-    if (tilt && cfg->tilt_invert) step = -step;
+/* Name, and the single-axis direction each axis moves in (PTZ_DIR_NONE: stays put). */
+static const struct {
+    const char *name;
+    ptz_dir_t axis[2];
+} DIRS[PTZ_DIR_COUNT] = {
+    [PTZ_DIR_NONE]       = { "",           { PTZ_DIR_NONE,  PTZ_DIR_NONE } },
+    [PTZ_DIR_LEFT]       = { "left",       { PTZ_DIR_LEFT,  PTZ_DIR_NONE } },
+    [PTZ_DIR_RIGHT]      = { "right",      { PTZ_DIR_RIGHT, PTZ_DIR_NONE } },
+    [PTZ_DIR_UP]         = { "up",         { PTZ_DIR_NONE,  PTZ_DIR_UP } },
+    [PTZ_DIR_DOWN]       = { "down",       { PTZ_DIR_NONE,  PTZ_DIR_DOWN } },
+    [PTZ_DIR_UP_LEFT]    = { "up-left",    { PTZ_DIR_LEFT,  PTZ_DIR_UP } },
+    [PTZ_DIR_UP_RIGHT]   = { "up-right",   { PTZ_DIR_RIGHT, PTZ_DIR_UP } },
+    [PTZ_DIR_DOWN_LEFT]  = { "down-left",  { PTZ_DIR_LEFT,  PTZ_DIR_DOWN } },
+    [PTZ_DIR_DOWN_RIGHT] = { "down-right", { PTZ_DIR_RIGHT, PTZ_DIR_DOWN } },
+    [PTZ_DIR_IN]         = { "in",         { PTZ_DIR_NONE,  PTZ_DIR_NONE } },
+    [PTZ_DIR_OUT]        = { "out",        { PTZ_DIR_NONE,  PTZ_DIR_NONE } },
+};
 
-    return step;
+const char *ptz_dir_name(ptz_dir_t dir) {
+    return ((unsigned)dir < PTZ_DIR_COUNT) ? DIRS[dir].name : "";
 }
 
-typedef struct { const char *dir; ptz_axis_t axis; int sign; } dirspec_t;
-static const dirspec_t DIRS[] = {
-    { "left",  PTZ_AXIS_PAN,  -1 },
-    { "right", PTZ_AXIS_PAN,   1 },
-    { "up",    PTZ_AXIS_TILT,  1 },
-    { "down",  PTZ_AXIS_TILT, -1 },
-};
-
-static const dirspec_t *find_dir(const char *dir) {
-    for (size_t i = 0; i < sizeof(DIRS) / sizeof(DIRS[0]); i++) {
-        if (strcmp(dir, DIRS[i].dir) == 0) return &DIRS[i];
+static ptz_dir_t find_dir(const char *s, size_t n) {
+    for (int d = PTZ_DIR_LEFT; d < PTZ_DIR_COUNT; d++) {
+        if (strlen(DIRS[d].name) == n && strncmp(s, DIRS[d].name, n) == 0) return (ptz_dir_t)d;
     }
-    return NULL;
+    return PTZ_DIR_NONE;
 }
 
-static void pick_mult_rep(const ptz_config_t *c, const char *dir, int *mult, int *rep) {
-    if (strcmp(dir, "left") == 0 || strcmp(dir, "right") == 0) {
-        *mult = (c->pan_step_mult > 0) ? c->pan_step_mult : c->step_mult;
-        *rep  = (c->pan_step_repeat > 0) ? c->pan_step_repeat : c->step_repeat;
-        return;
+ptz_dir_t ptz_dir_parse(const char *s) {
+    if (!s) return PTZ_DIR_NONE;
+    ptz_dir_t d = find_dir(s, strlen(s));
+    if (d != PTZ_DIR_NONE) return d;
+
+    /* "left-up": the other order of a diagonal. */
+    const char *dash = strchr(s, '-');
+    if (!dash) return PTZ_DIR_NONE;
+    ptz_dir_t d1 = find_dir(s, (size_t)(dash - s)), d2 = find_dir(dash + 1, strlen(dash + 1));
+    if (d1 < PTZ_DIR_LEFT || d1 > PTZ_DIR_RIGHT || d2 < PTZ_DIR_UP || d2 > PTZ_DIR_DOWN) return PTZ_DIR_NONE;
+    for (int i = PTZ_DIR_UP_LEFT; i <= PTZ_DIR_DOWN_RIGHT; i++) {
+        if (DIRS[i].axis[PTZ_AXIS_PAN] == d1 && DIRS[i].axis[PTZ_AXIS_TILT] == d2) return (ptz_dir_t)i;
     }
+    return PTZ_DIR_NONE;
+}
 
-    int m = (c->tilt_step_mult > 0) ? c->tilt_step_mult : c->step_mult;
-    int r = (c->tilt_step_repeat > 0) ? c->tilt_step_repeat : c->step_repeat;
+void ptz_dir_init(ptz_ctx_t *ctx) {
+    const ptz_config_t *c = &ctx->cfg;
+    ctx->dirs[PTZ_DIR_NONE].mult = ctx->dirs[PTZ_DIR_NONE].rep = 1;
+    ctx->dirs[PTZ_DIR_NONE].polarity = 1;
+    ctx->dirs[PTZ_DIR_NONE].abs_max = 0;
+
+    for (int d = PTZ_DIR_LEFT; d <= PTZ_DIR_DOWN; d++) {
+        bool pan = (d == PTZ_DIR_LEFT || d == PTZ_DIR_RIGHT);
+        bool positive = (d == PTZ_DIR_RIGHT || d == PTZ_DIR_UP);
+        int m, r, lim[2] = { 0, 0 };
+        if (pan) {
+            m = (c->pan_step_mult > 0) ? c->pan_step_mult : c->step_mult;
+            r = (c->pan_step_repeat > 0) ? c->pan_step_repeat : c->step_repeat;
+        } else {
+            m = (c->tilt_step_mult > 0) ? c->tilt_step_mult : c->step_mult;
+            r = (c->tilt_step_repeat > 0) ? c->tilt_step_repeat : c->step_repeat;
+            int up_m = positive ? c->tilt_up_step_mult : c->tilt_down_step_mult;
+            int up_r = positive ? c->tilt_up_step_repeat : c->tilt_down_step_repeat;
+            if (up_m > 0) m = up_m;
+            if (up_r > 0) r = up_r;
+            lim[0] = c->tilt_step_abs_max;
+            lim[1] = positive ? c->tilt_up_step_abs_max : c->tilt_down_step_abs_max;
+        }
 
-    if (strcmp(dir, "up") == 0) {
-        if (c->tilt_up_step_mult > 0) m = c->tilt_up_step_mult;
-        if (c->tilt_up_step_repeat > 0) r = c->tilt_up_step_repeat;
-    } else if (strcmp(dir, "down") == 0) {
-        if (c->tilt_down_step_mult > 0) m = c->tilt_down_step_mult;
-        if (c->tilt_down_step_repeat > 0) r = c->tilt_down_step_repeat;
-    }
+        /* The clamps applied one after another amount to the tightest one set. */
+        int abs_max = 0;
+        for (int i = 0; i < 2; i++) {
+            if (lim[i] > 0 && (!abs_max || lim[i] < abs_max)) abs_max = lim[i];
+        }
 
-    *mult = m;
-    *rep = r;
+        ctx->dirs[d].mult = (m > 1) ? m : 1;
+        ctx->dirs[d].rep = (r > 1) ? r : 1;
+        ctx->dirs[d].polarity = ptz_drive_steps(ctx, pan ? PTZ_AXIS_PAN : PTZ_AXIS_TILT, positive ? 1 : -1);
+        ctx->dirs[d].abs_max = abs_max;
+    }
 }
 
 /* Set driver velocity using IOCTL_SET_SPEED, scaling per requested ONVIF speed factor. */
-static int set_speed_if_needed(const ptz_config_t *c, ptz_axis_t a, const char *dir, double factor) {
+static int set_speed_if_needed(ptz_ctx_t *ctx, ptz_axis_t a, ptz_dir_t dir, double factor) {
+    const ptz_config_t *c = &ctx->cfg;
     if (!c->set_speed_each_move) return 0;
 
     int base = ptz_axis_speed_step(c, a);
@@ -96,173 +121,268 @@ static int set_speed_if_needed(const ptz_config_t *c, ptz_axis_t a, const char *
     if (speed_step < 1) speed_step = 1;
     if (speed_step > base) speed_step = base;
 
-    return ptz_issue_motor(c, a, dir, speed_step, 1, c->ioctl_set_speed, true);
+    return ptz_issue_motor(ctx, a, ptz_dir_name(dir), speed_step, 1, c->ioctl_set_speed, true);
 }
 
-static int run_axis_delta(const ptz_config_t *cfg,
-                          ptz_axis_t axis,
-                          const char *dir,
-                          int delta_deg,
-                          int total_steps,
-                          int max_deg) {
-    if (!delta_deg) return 0;
-
-    int rem = deg_to_steps(abs(delta_deg), total_steps, max_deg);
-    int sign = (delta_deg < 0) ? -1 : 1;
-
-    int chunk = cfg->absrel_chunk_steps;
-    if (chunk < 1) chunk = 1;
-
-    int interval_ms = cfg->absrel_interval_ms;
-    if (interval_ms < 0) interval_ms = 0;
-
-    unsigned long fd_addr = ptz_axis_fd_addr(cfg, axis);
-
-    if (cfg->set_speed_each_move) {
-        /* abs/rel moves have no explicit speed argument; use configured full speed. */
-        if (set_speed_if_needed(cfg, axis, dir, 1.0) != 0) {
-            ptz_log_line(cfg, "absrel speed set failed dir=%s speed_step=%d addr=0x%lx",
-                         dir, ptz_axis_speed_step(cfg, axis), fd_addr);
-        }
-    }
-
-    while (rem > 0) {
-        int one = (rem > chunk) ? chunk : rem;
-        int step = apply_dir_polarity(cfg, dir, sign * one);
-
-        if (ptz_issue_motor(cfg, axis, dir, step, 1, cfg->ioctl_move, false) != 0) {
-            ptz_log_line(cfg, "absrel move failed dir=%s step=%d addr=0x%lx", dir, step, fd_addr);
-            return 1;
-        }
-
-        rem -= one;
-        if (interval_ms) ptz_sleep_us((long)interval_ms * 1000);
-    }
-
-    return 0;
+/* Start moving pan by dx and tilt by dy steps, ending at position `to` (steps). With the planner both axes move
+   at once and arrive together; otherwise (a moving axis has no MAX_VEL/ACCEL limits) pan runs, then tilt. */
+static int start_pan_tilt_delta(ptz_ctx_t *ctx, int dx, int dy, const int to[3]) {
+    ptz_dir_t px = (dx < 0) ? PTZ_DIR_LEFT : PTZ_DIR_RIGHT, ty = (dy < 0) ? PTZ_DIR_DOWN : PTZ_DIR_UP;
+    ptz_plan_leg_t leg[2] = {
+        { abs(dx), ctx->dirs[px].polarity, px },
+        { abs(dy), ctx->dirs[ty].polarity, ty },
+    };
+    return ptz_plan_start(ctx, leg, to, NULL);
 }
 
 int ptz_ctx_init(ptz_ctx_t *ctx, const ptz_config_t *cfg) {
     if (!ctx || !cfg) return -1;
     ctx->cfg = *cfg;
+    ctx->clock = NULL;
+    ptz_kin_init(ctx);
+    ptz_dir_init(ctx);
     for (int i = 0; i < 2; i++) {
         ctx->cont[i].active = false;
-        ctx->cont[i].dir[0] = '\0';
+        ctx->cont[i].dir = PTZ_DIR_NONE;
         ctx->cont[i].step = 0;
         ctx->cont[i].rep = 1;
         ctx->cont[i].fd_addr = 0;
         ctx->cont[i].next_due.tv_sec = 0;
         ctx->cont[i].next_due.tv_nsec = 0;
+        ctx->cont[i].interval_us = 0;
+        ctx->cont[i].speed = 0;
+        ctx->motor[i].fd = -1;
+        ctx->motor[i].borrowed = false;
+        ctx->motor[i].no_state = false;
+        ctx->motor[i].via[0] = '\0';
     }
+    ctx->move.id = 0;
+    ctx->move.active = false;
+    ctx->move.failed = false;
+    ctx->move.preempted = false;
+    ctx->tour.active = false;
+    ctx->tour.n = 0;
+    ctx->motion_gen = 0;
+    ctx->proc.pid = -1;
+    ctx->proc.start_time = 0;
+    ctx->proc.pidfd = -1;
+    ctx->reload.fd = -1;
+    ctx->cmdq.ring = NULL;
+    ctx->cmdq.bytes = 0;
+    ctx->cmdq.efd = -1;
     ptz_ensure_state_dir(&ctx->cfg);
+    if (ptz_state_open(ctx) != 0) {
+        ptz_log_line(&ctx->cfg, "state mmap unavailable in %s, using text position file", ctx->cfg.state_dir);
+    }
+    if (ptz_trace_open(ctx) != 0) ptz_log_line(&ctx->cfg, "trace %s unavailable, not tracing", ctx->cfg.trace_file);
+    ptz_sim_init(ctx);
     return 0;
 }
 
-int ptz_move_dir(ptz_ctx_t *ctx, const char *dir, const char *speed) {
-    if (!ctx || !dir || !*dir) return -1;
-
-    int deg = speed_to_deg(speed);
-    double speed_factor = parse_speed_factor(speed);
-    int x, y, z;
+void ptz_ctx_close(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+    ptz_motor_close(ctx);
+    ptz_state_close(ctx);
+    ptz_trace_close(ctx);
+    ptz_cmdq_close_consumer(ctx);
+    if (ctx->reload.fd >= 0) close(ctx->reload.fd);
+    ctx->reload.fd = -1;
+    ptz_log_flush();
+}
 
-    if (strcmp(dir, "in") == 0 || strcmp(dir, "out") == 0) {
-        (void)ptz_get_position(ctx, &x, &y, &z);
+/* Driver step for one command in single-axis direction `d` (multiplier, inversion and tilt clamps applied), its
+   repeat count, and the SET_SPEED for this move. */
+static int axis_command(ptz_ctx_t *ctx, ptz_axis_t a, ptz_dir_t d, int deg, double factor, int *step_out, int *rep_out) {
+    int base_step = ptz_deg_to_steps(ctx, a, deg);
+    if (base_step < 1) base_step = 1;
 
-        if (ctx->cfg.zoom_supported) {
-            z += (strcmp(dir, "in") == 0) ? deg : -deg;
-            z = ptz_clampi(z, 0, 100);
-            (void)ptz_set_position(ctx, x, y, z);
-        }
+    *step_out = clamp_abs_step(ctx->dirs[d].polarity * base_step * ctx->dirs[d].mult, ctx->dirs[d].abs_max);
+    *rep_out = ctx->dirs[d].rep;
 
-        ptz_log_line(&ctx->cfg,
-                     "move dir=%s speed=%s deg=%d base_step=0 step=0 mult=%d rep=%d invert=%d/%d pos=%d,%d,%d",
-                     dir, speed ? speed : "", deg,
-                     ctx->cfg.step_mult, ctx->cfg.step_repeat,
-                     ctx->cfg.pan_invert, ctx->cfg.tilt_invert,
-                     x, y, z);
-        return 0;
+    if (set_speed_if_needed(ctx, a, d, factor) != 0) {
+        ptz_log_line(&ctx->cfg, "speed set failed dir=%s speed_step=%d factor=%g addr=0x%lx",
+                     ptz_dir_name(d), ptz_axis_speed_step(&ctx->cfg, a), factor, ptz_axis_fd_addr(&ctx->cfg, a));
     }
+    return base_step;
+}
 
-    const dirspec_t *ds = find_dir(dir);
-    if (!ds) return -1;
-
-    int total_steps = (ds->axis == PTZ_AXIS_PAN) ? ctx->cfg.pan_total_steps : ctx->cfg.tilt_total_steps;
-    int max_deg     = (ds->axis == PTZ_AXIS_PAN) ? ctx->cfg.pan_max_deg : ctx->cfg.tilt_max_deg;
-
-    int base_step = deg_to_steps(deg, total_steps, max_deg);
-
-    int mult = 1, rep = 1;
-    pick_mult_rep(&ctx->cfg, dir, &mult, &rep);
-
-    int step = ds->sign * base_step;
-    if (mult > 1) step *= mult;
-
-    step = apply_dir_polarity(&ctx->cfg, dir, step);
+/* Zoom has no motor: in/out only move the stored zoom. */
+static int move_zoom(ptz_ctx_t *ctx, ptz_dir_t dir, double speed) {
+    int deg = speed_to_deg(speed);
+    int ps, ts, z;
+    (void)ptz_get_position_steps(ctx, &ps, &ts, &z);
 
-    if (ds->axis == PTZ_AXIS_TILT) {
-        step = clamp_abs_step(step, ctx->cfg.tilt_step_abs_max);
-        if (strcmp(dir, "up") == 0) step = clamp_abs_step(step, ctx->cfg.tilt_up_step_abs_max);
-        if (strcmp(dir, "down") == 0) step = clamp_abs_step(step, ctx->cfg.tilt_down_step_abs_max);
+    if (ctx->cfg.zoom_supported) {
+        z += (dir == PTZ_DIR_IN) ? deg : -deg;
+        z = ptz_clampi(z, 0, 100);
+        (void)ptz_set_position_steps(ctx, ps, ts, z);
     }
+    int x = ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, ps);
+    int y = ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, ts);
 
-    unsigned long fd_addr = ptz_axis_fd_addr(&ctx->cfg, ds->axis);
+    ptz_log_line(&ctx->cfg,
+                 "move dir=%s speed=%g deg=%d base_step=0 step=0 mult=%d rep=%d invert=%d/%d pos=%d,%d,%d",
+                 ptz_dir_name(dir), speed, deg,
+                 ctx->cfg.step_mult, ctx->cfg.step_repeat,
+                 ctx->cfg.pan_invert, ctx->cfg.tilt_invert,
+                 x, y, z);
+    return 0;
+}
 
-    if (set_speed_if_needed(&ctx->cfg, ds->axis, dir, speed_factor) != 0) {
-        ptz_log_line(&ctx->cfg, "speed set failed dir=%s speed_step=%d factor=%g addr=0x%lx",
-                     dir, ptz_axis_speed_step(&ctx->cfg, ds->axis), speed_factor, fd_addr);
+/* Start one command on each axis `dir` moves. In continuous mode both axes are armed with the same next_due,
+   so every tick issues them together and a diagonal stays diagonal. */
+/* Axis `failed` of a direction move could not be started: stop the ones before it and take back their
+   dead-reckoned steps, so a half-started diagonal leaves nothing running. */
+static void move_abort(ptz_ctx_t *ctx, const ptz_dir_t *ds, int failed, const int moved[2]) {
+    for (int a = 0; a < failed; a++) {
+        if (!ds[a]) continue;
+        if (ctx->cfg.continuous_mode) {
+            ptz_continuous_disarm(ctx, (ptz_axis_t)a); /* armed, but not ticked yet */
+            continue;
+        }
+        (void)ptz_issue_motor(ctx, (ptz_axis_t)a, "", 0, 1, ctx->cfg.ioctl_stop, true);
+        (void)ptz_add_position_steps(ctx, (a == PTZ_AXIS_PAN) ? -moved[a] : 0, (a == PTZ_AXIS_TILT) ? -moved[a] : 0);
     }
+}
+
+int ptz_move(ptz_ctx_t *ctx, ptz_dir_t dir, double speed) {
+    if (!ctx || dir <= PTZ_DIR_NONE || dir >= PTZ_DIR_COUNT) return -1;
+    speed = fabs(speed);
+    if (dir == PTZ_DIR_IN || dir == PTZ_DIR_OUT) return move_zoom(ctx, dir, speed);
 
-    if (ctx->cfg.continuous_mode) {
-        int div = ctx->cfg.continuous_step_div;
-        if (div < 1) div = 1;
+    const ptz_dir_t *ds = DIRS[dir].axis;
+    int deg = speed_to_deg(speed);
+    double factor = speed_factor(speed);
 
-        int run_step = step / div;
-        if (!run_step) run_step = (step < 0) ? -1 : 1;
+    /* A direction move takes over from any abs/rel/preset move still running, here or in another process. */
+    ptz_plan_preempt(ctx);
+    ptz_motion_claim(ctx);
 
-        int run_rep = ctx->cfg.continuous_rep;
-        if (run_rep < 1) run_rep = 1;
+    int step[2] = { 0, 0 }, rep[2] = { 1, 1 }, base_step[2] = { 0, 0 };
+    for (int a = 0; a < 2; a++) {
+        if (ds[a]) base_step[a] = axis_command(ctx, (ptz_axis_t)a, ds[a], deg, factor, &step[a], &rep[a]);
+    }
 
-        if (ptz_continuous_arm(ctx, ds->axis, dir, run_step, run_rep) != 0) {
-            ptz_log_line(&ctx->cfg, "move failed continuous_arm dir=%s step=%d addr=0x%lx", dir, step, fd_addr);
-            return 1;
-        }
-    } else {
-        if (ptz_issue_motor(&ctx->cfg, ds->axis, dir, step, rep, ctx->cfg.ioctl_move, true) != 0) {
-            ptz_log_line(&ctx->cfg, "move failed dir=%s step=%d addr=0x%lx", dir, step, fd_addr);
-            return 1;
+    struct timespec now = { 0, 0 };
+    (void)ptz_ctx_now(ctx, &now);
+
+    int moved[2] = { 0, 0 };
+    for (int a = 0; a < 2; a++) {
+        if (!ds[a]) continue;
+        unsigned long fd_addr = ptz_axis_fd_addr(&ctx->cfg, (ptz_axis_t)a);
+
+        if (ctx->cfg.continuous_mode) {
+            int div = ctx->cfg.continuous_step_div;
+            if (div < 1) div = 1;
+
+            int run_step = step[a] / div;
+            if (!run_step) run_step = (step[a] < 0) ? -1 : 1;
+
+            int run_rep = ctx->cfg.continuous_rep;
+            if (run_rep < 1) run_rep = 1;
+
+            if (ptz_continuous_arm(ctx, (ptz_axis_t)a, ds[a], run_step, run_rep) != 0) {
+                ptz_log_line(&ctx->cfg, "move failed continuous_arm dir=%s step=%d addr=0x%lx", ptz_dir_name(ds[a]),
+                             step[a], fd_addr);
+                move_abort(ctx, ds, a, moved);
+                return 1;
+            }
+            ctx->cont[a].next_due = now;
+        } else {
+            if (ptz_issue_motor(ctx, (ptz_axis_t)a, ptz_dir_name(ds[a]), step[a], rep[a], ctx->cfg.ioctl_move, true) != 0) {
+                ptz_log_line(&ctx->cfg, "move failed dir=%s step=%d addr=0x%lx", ptz_dir_name(ds[a]), step[a], fd_addr);
+                move_abort(ctx, ds, a, moved);
+                return 1;
+            }
+            /* Dead-reckon one step per command: a MOVE replaces the target still in flight, so STEP_REPEAT
+               keeps the motor going rather than adding distance. Continuous moves add theirs on every tick. */
+            moved[a] = ptz_drive_steps(ctx, (ptz_axis_t)a, step[a]);
+            (void)ptz_add_position_steps(ctx, (a == PTZ_AXIS_PAN) ? moved[a] : 0, (a == PTZ_AXIS_TILT) ? moved[a] : 0);
         }
     }
+    if (!ctx->cfg.continuous_mode) (void)ptz_export_position(ctx);
 
+    int x, y, z;
     (void)ptz_get_position(ctx, &x, &y, &z);
-    if (ds->axis == PTZ_AXIS_PAN) x += ds->sign * deg;
-    else y += ds->sign * deg;
-
-    x = ptz_clampi(x, 0, ctx->cfg.pan_max_deg);
-    y = ptz_clampi(y, 0, ctx->cfg.tilt_max_deg);
-    z = ptz_clampi(z, 0, 100);
-
-    (void)ptz_set_position(ctx, x, y, z);
+    for (int a = 0; a < 2; a++) {
+        if (!ds[a]) continue;
+        ptz_log_line(&ctx->cfg,
+                     "move dir=%s speed=%g factor=%g deg=%d base_step=%d step=%d mult=%d rep=%d invert=%d/%d pos=%d,%d,%d",
+                     ptz_dir_name(dir), speed, factor, deg, base_step[a], step[a], ctx->dirs[ds[a]].mult, rep[a],
+                     ctx->cfg.pan_invert, ctx->cfg.tilt_invert, x, y, z);
+    }
+    return 0;
+}
 
-    ptz_log_line(&ctx->cfg,
-                 "move dir=%s speed=%s factor=%g deg=%d base_step=%d step=%d mult=%d rep=%d invert=%d/%d pos=%d,%d,%d",
-                 dir, speed ? speed : "", speed_factor, deg, base_step, step, mult, rep,
-                 ctx->cfg.pan_invert, ctx->cfg.tilt_invert, x, y, z);
+int ptz_move_dir(ptz_ctx_t *ctx, const char *dir, const char *speed) {
+    if (!ctx || !dir) return -1;
+    return ptz_move(ctx, ptz_dir_parse(dir), (speed && *speed) ? atof(speed) : PTZ_SPEED_DEFAULT);
+}
 
-    return 0;
+int ptz_move_vector(ptz_ctx_t *ctx, int pan, int tilt, const char *speed) {
+    if (!ctx) return -1;
+    if (!pan && !tilt) return ptz_stop(ctx);
+
+    static const ptz_dir_t BY_SIGN[3][3] = { /* [tilt + 1][pan + 1] */
+        { PTZ_DIR_DOWN_LEFT, PTZ_DIR_DOWN, PTZ_DIR_DOWN_RIGHT },
+        { PTZ_DIR_LEFT,      PTZ_DIR_NONE, PTZ_DIR_RIGHT },
+        { PTZ_DIR_UP_LEFT,   PTZ_DIR_UP,   PTZ_DIR_UP_RIGHT },
+    };
+    ptz_dir_t dir = BY_SIGN[(tilt > 0) - (tilt < 0) + 1][(pan > 0) - (pan < 0) + 1];
+    return ptz_move(ctx, dir, (speed && *speed) ? atof(speed) : PTZ_SPEED_DEFAULT);
 }
 
 int ptz_stop(ptz_ctx_t *ctx) {
     if (!ctx) return -1;
+    ptz_motion_claim(ctx); /* another process ticking a move drops it on its next tick */
+    ptz_tour_end(ctx, "stopped");
+    (void)ptz_plan_cancel(ctx);
+    bool was_continuous = ctx->cont[PTZ_AXIS_PAN].active || ctx->cont[PTZ_AXIS_TILT].active;
     ptz_continuous_disarm(ctx, PTZ_AXIS_PAN);
     ptz_continuous_disarm(ctx, PTZ_AXIS_TILT);
+    if (was_continuous) (void)ptz_export_position(ctx); /* ticks only updated the mapped state */
 
     /* Best-effort motor stop. Some firmwares ignore this and only stop when commands stop arriving. */
-    (void)ptz_issue_motor(&ctx->cfg, PTZ_AXIS_PAN,  "", 0, 1, ctx->cfg.ioctl_stop, true);
-    (void)ptz_issue_motor(&ctx->cfg, PTZ_AXIS_TILT, "", 0, 1, ctx->cfg.ioctl_stop, true);
+    (void)ptz_issue_motor(ctx, PTZ_AXIS_PAN,  "", 0, 1, ctx->cfg.ioctl_stop, true);
+    (void)ptz_issue_motor(ctx, PTZ_AXIS_TILT, "", 0, 1, ctx->cfg.ioctl_stop, true);
     ptz_log_line(&ctx->cfg, "move stop");
     return 0;
 }
 
+int ptz_is_moving(ptz_ctx_t *ctx) {
+    if (!ctx) return -1;
+    if (ctx->cont[PTZ_AXIS_PAN].active || ctx->cont[PTZ_AXIS_TILT].active || ctx->move.active) return 1;
+
+    /* Unknown driver state (no GET_STATE) counts as idle, as the old hard-coded answer did. */
+    return (ptz_motor_running(ctx, PTZ_AXIS_PAN) > 0 || ptz_motor_running(ctx, PTZ_AXIS_TILT) > 0) ? 1 : 0;
+}
+
+int ptz_wait_idle(ptz_ctx_t *ctx, int timeout_ms) {
+    if (!ctx) return -1;
+
+    struct timespec now, deadline = { 0, 0 };
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+    if (timeout_ms >= 0) deadline = ptz_timespec_add_us(now, (long)timeout_ms * 1000L);
+
+    long poll_us = 0;
+    for (;;) {
+        if (ptz_tick(ctx) < 0) return -1;
+        if (!ptz_is_moving(ctx)) return 0;
+
+        if (ptz_ctx_now(ctx, &now) != 0) return -1;
+        if (timeout_ms >= 0 && ptz_timespec_ge(&now, &deadline)) return 1;
+
+        /* Our own moves: sleep until the next tick. Otherwise only the driver is busy: poll it with backoff. */
+        struct timespec wake;
+        if (ptz_next_deadline(ctx, &wake) <= 0) {
+            poll_us = ptz_state_poll_next(poll_us);
+            wake = ptz_timespec_add_us(now, poll_us);
+        }
+        if (timeout_ms >= 0 && ptz_timespec_ge(&wake, &deadline)) wake = deadline;
+        ptz_ctx_sleep_until(ctx, &wake);
+    }
+}
+
 int ptz_home(ptz_ctx_t *ctx) {
     if (!ctx) return -1;
 
@@ -274,75 +394,123 @@ int ptz_home(ptz_ctx_t *ctx) {
 
     /* Prefer driver-supported homing/centering when available. */
     if (ctx->cfg.ioctl_turn_middle) {
-        rc_pan = ptz_motor_turn_middle(&ctx->cfg, PTZ_AXIS_PAN, true);
-        rc_tilt = ptz_motor_turn_middle(&ctx->cfg, PTZ_AXIS_TILT, true);
+        rc_pan = ptz_motor_turn_middle(ctx, PTZ_AXIS_PAN, true);
+        rc_tilt = ptz_motor_turn_middle(ctx, PTZ_AXIS_TILT, true);
     }
 
     /* Persist expected centered position even if driver doesn't report back.
        If the ioctl fails on both axes, we still keep the old behavior (state-only home).
        Caller can treat negative return as a hint that hardware centering did not run. */
-    int x = ctx->cfg.pan_max_deg / 2;
-    int y = ctx->cfg.tilt_max_deg / 2;
-    (void)ptz_set_position(ctx, x, y, 0);
+    (void)ptz_set_position_steps(ctx, ctx->kin[PTZ_AXIS_PAN].total_steps / 2, ctx->kin[PTZ_AXIS_TILT].total_steps / 2, 0);
 
     ptz_log_line(&ctx->cfg, "move home rc_pan=%d rc_tilt=%d", rc_pan, rc_tilt);
     if (rc_pan < 0 && rc_tilt < 0) return -1;
     return 0;
 }
 
-int ptz_move_abs(ptz_ctx_t *ctx, double x, double y, double z) {
-    if (!ctx) return -1;
+/* Absolute move to a step position; the degree and normalized variants convert and call this. */
+static int move_abs_steps_start(ptz_ctx_t *ctx, int pan, int tilt, int zoom) {
+    int to[3] = {
+        ptz_clampi(pan, 0, ctx->kin[PTZ_AXIS_PAN].total_steps),
+        ptz_clampi(tilt, 0, ctx->kin[PTZ_AXIS_TILT].total_steps),
+        ptz_clampi(zoom, 0, 100),
+    };
 
-    int px = ptz_clampi((int)((x + 1.0) * (ctx->cfg.pan_max_deg / 2.0)), 0, ctx->cfg.pan_max_deg);
-    int py = ptz_clampi((int)((y + 1.0) * (ctx->cfg.tilt_max_deg / 2.0)), 0, ctx->cfg.tilt_max_deg);
-    int pz = ptz_clampi((int)((z + 1.0) * 50.0), 0, 100);
+    /* A running move is preempted first, so the delta is taken from where it got to. */
+    ptz_plan_preempt(ctx);
 
     int cx, cy, cz;
-    (void)ptz_get_position(ctx, &cx, &cy, &cz);
+    (void)ptz_get_position_steps(ctx, &cx, &cy, &cz);
     (void)cz;
 
-    int dx = px - cx;
-    int dy = py - cy;
+    return start_pan_tilt_delta(ctx, to[0] - cx, to[1] - cy, to);
+}
 
-    if (dx && run_axis_delta(&ctx->cfg, PTZ_AXIS_PAN, (dx > 0) ? "right" : "left",
-                             dx, ctx->cfg.pan_total_steps, ctx->cfg.pan_max_deg))
-        return 1;
+int ptz_move_abs_deg_start(ptz_ctx_t *ctx, int px, int py, int pz) {
+    if (!ctx) return -1;
+    return move_abs_steps_start(ctx, ptz_deg_to_steps(ctx, PTZ_AXIS_PAN, px), ptz_deg_to_steps(ctx, PTZ_AXIS_TILT, py), pz);
+}
 
-    if (dy && run_axis_delta(&ctx->cfg, PTZ_AXIS_TILT, (dy > 0) ? "up" : "down",
-                             dy, ctx->cfg.tilt_total_steps, ctx->cfg.tilt_max_deg))
-        return 1;
+int ptz_move_abs_deg(ptz_ctx_t *ctx, int px, int py, int pz) {
+    if (ptz_move_abs_deg_start(ctx, px, py, pz) != 0) return -1;
+    return ptz_move_wait(ctx);
+}
 
-    (void)ptz_set_position(ctx, px, py, pz);
-    ptz_log_line(&ctx->cfg, "move abs -> pos=%d,%d,%d (norm=%g,%g,%g)", px, py, pz, x, y, z);
+int ptz_move_abs_start(ptz_ctx_t *ctx, double x, double y, double z) {
+    if (!ctx) return -1;
+
+    int px = ptz_norm_to_steps(ctx, PTZ_AXIS_PAN, x);
+    int py = ptz_norm_to_steps(ctx, PTZ_AXIS_TILT, y);
+    int pz = ptz_clampi((int)((z + 1.0) * 50.0), 0, 100);
+
+    int rc = move_abs_steps_start(ctx, px, py, pz);
+    if (rc != 0) return rc;
+
+    ptz_log_line(&ctx->cfg, "move abs -> pos=%d,%d,%d steps=%d,%d (norm=%g,%g,%g)",
+                 ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, px), ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, py), pz, px, py, x, y, z);
     return 0;
 }
 
-int ptz_move_rel(ptz_ctx_t *ctx, double dx, double dy, double dz) {
+int ptz_move_abs(ptz_ctx_t *ctx, double x, double y, double z) {
+    if (ptz_move_abs_start(ctx, x, y, z) != 0) return -1;
+    return ptz_move_wait(ctx);
+}
+
+int ptz_move_rel_start(ptz_ctx_t *ctx, double dx, double dy, double dz) {
     if (!ctx) return -1;
+    ptz_plan_preempt(ctx);
 
     int x, y, z;
-    (void)ptz_get_position(ctx, &x, &y, &z);
-
-    int mdx = (int)(dx * (ctx->cfg.pan_max_deg / 2.0));
-    int mdy = (int)(dy * (ctx->cfg.tilt_max_deg / 2.0));
+    (void)ptz_get_position_steps(ctx, &x, &y, &z);
 
-    if (mdx && run_axis_delta(&ctx->cfg, PTZ_AXIS_PAN, (mdx > 0) ? "right" : "left",
-                              mdx, ctx->cfg.pan_total_steps, ctx->cfg.pan_max_deg))
-        return 1;
+    /* [-1,1] spans the whole axis, so a delta of 1 is half of it. */
+    int mdx = (int)(dx * (ctx->kin[PTZ_AXIS_PAN].total_steps / 2.0));
+    int mdy = (int)(dy * (ctx->kin[PTZ_AXIS_TILT].total_steps / 2.0));
 
-    if (mdy && run_axis_delta(&ctx->cfg, PTZ_AXIS_TILT, (mdy > 0) ? "up" : "down",
-                              mdy, ctx->cfg.tilt_total_steps, ctx->cfg.tilt_max_deg))
-        return 1;
+    /* The motors get the full delta (the driver stops at its end stops); the state stays in range. */
+    int to[3] = {
+        ptz_clampi(x + mdx, 0, ctx->kin[PTZ_AXIS_PAN].total_steps),
+        ptz_clampi(y + mdy, 0, ctx->kin[PTZ_AXIS_TILT].total_steps),
+        ptz_clampi(z + (int)(dz * 10.0), 0, 100),
+    };
 
-    x = ptz_clampi(x + mdx, 0, ctx->cfg.pan_max_deg);
-    y = ptz_clampi(y + mdy, 0, ctx->cfg.tilt_max_deg);
-    z = ptz_clampi(z + (int)(dz * 10.0), 0, 100);
+    int rc = start_pan_tilt_delta(ctx, mdx, mdy, to);
+    if (rc != 0) return rc;
 
-    (void)ptz_set_position(ctx, x, y, z);
-    ptz_log_line(&ctx->cfg, "move rel -> pos=%d,%d,%d (delta=%g,%g,%g)", x, y, z, dx, dy, dz);
+    ptz_log_line(&ctx->cfg, "move rel -> pos=%d,%d,%d steps=%d,%d (delta=%g,%g,%g)",
+                 ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, to[0]), ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, to[1]), to[2],
+                 to[0], to[1], dx, dy, dz);
     return 0;
 }
 
+int ptz_move_rel(ptz_ctx_t *ctx, double dx, double dy, double dz) {
+    if (ptz_move_rel_start(ctx, dx, dy, dz) != 0) return -1;
+    return ptz_move_wait(ctx);
+}
+
+/* Another process has issued a motion command since ours: it owns the motors now. */
+static void drop_superseded(ptz_ctx_t *ctx) {
+    bool armed = ctx->cont[PTZ_AXIS_PAN].active || ctx->cont[PTZ_AXIS_TILT].active || ctx->move.active ||
+                 ctx->tour.active;
+    if (!armed || !ptz_motion_superseded(ctx)) return;
+
+    ptz_log_line(&ctx->cfg, "motion taken over by pid %d, dropping our move",
+                 (int)atomic_load_explicit(&ctx->state->owner_pid, memory_order_relaxed));
+    ptz_tour_end(ctx, NULL);
+    (void)ptz_plan_cancel(ctx);
+    ptz_continuous_disarm(ctx, PTZ_AXIS_PAN);
+    ptz_continuous_disarm(ctx, PTZ_AXIS_TILT);
+    (void)ptz_export_position(ctx);
+}
+
 int ptz_tick(ptz_ctx_t *ctx) {
-    return ptz_continuous_tick(ctx);
+    if (!ctx) return -1;
+    drop_superseded(ctx);
+
+    int rc = ptz_continuous_tick(ctx);
+    int mrc = ptz_plan_tick(ctx);
+    int trc = ptz_tour_tick(ctx);
+    ptz_log_poll();
+    if (rc < 0 || mrc < 0 || trc < 0) return -1;
+    return (rc || mrc) ? 1 : 0;
 }
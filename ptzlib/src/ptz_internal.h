@@ -5,21 +5,213 @@
 #include "ptz_util.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum { PTZ_AXIS_PAN = 0, PTZ_AXIS_TILT = 1 } ptz_axis_t;
 
 const char *ptz_axis_name(ptz_axis_t a);
 unsigned long ptz_axis_fd_addr(const ptz_config_t *c, ptz_axis_t a);
 int ptz_axis_speed_step(const ptz_config_t *c, ptz_axis_t a);
+int ptz_axis_max_vel(const ptz_config_t *c, ptz_axis_t a);
+int ptz_axis_accel(const ptz_config_t *c, ptz_axis_t a);
+
+/* Number of keys whose values differ between a and b; their names, comma separated, into `keys`. */
+int ptz_config_diff(const ptz_config_t *a, const ptz_config_t *b, char *keys, size_t keys_sz);
 
 void ptz_state_path(const ptz_config_t *cfg, const char *name, char *out, size_t out_sz);
 void ptz_ensure_state_dir(const ptz_config_t *cfg);
 
+/* Layout of STATE_DIR/ptz_state.bin, shared (mmap) by every process using the library.
+   seq is a seqlock counter; see ptz_state.c. Bump STATE_VERSION when changing this. */
+struct ptz_state_shm {
+    _Atomic uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t seq;
+    uint32_t crc;
+    int32_t pan;  /* motor steps (v1: degrees) */
+    int32_t tilt;
+    int32_t zoom;
+    int32_t reserved;
+    /* v3: motion arbitration. Changed only inside a write section; read lock-free. */
+    _Atomic int32_t owner_pid;   /* process that issued the latest motion command */
+    _Atomic uint32_t motion_gen; /* bumped by every motion command */
+    /* v4: holder of the write section, 0 outside it, so a stuck seq is only taken over from a dead writer. */
+    _Atomic int32_t writer_pid;
+    _Atomic uint32_t writer_boot; /* boot the pid belongs to; see state_boot_id() */
+};
+
+int ptz_state_open(ptz_ctx_t *ctx);
+void ptz_state_close(ptz_ctx_t *ctx);
+
+/* Kinematics (ctx->kin, ptz_state.c). Steps are logical: 0..total_steps along the axis, before inversion. */
+void ptz_kin_init(ptz_ctx_t *ctx);
+int ptz_deg_to_steps(const ptz_ctx_t *ctx, ptz_axis_t a, int deg);
+int ptz_steps_to_deg(const ptz_ctx_t *ctx, ptz_axis_t a, int steps);
+/* ONVIF [-1,1] to an absolute step position (clamped). */
+int ptz_norm_to_steps(const ptz_ctx_t *ctx, ptz_axis_t a, double v);
+/* Logical steps -> the driver's step (applies PAN_INVERT/TILT_INVERT), and back. */
+static inline int ptz_drive_steps(const ptz_ctx_t *ctx, ptz_axis_t a, int steps) {
+    return ctx->kin[a].invert ? -steps : steps;
+}
+
+/* Fill ctx->dirs from the config (ptz_core.c). */
+void ptz_dir_init(ptz_ctx_t *ctx);
+
+/* Position in steps. The degree API in ptzctl.h converts at the boundary. */
+int ptz_get_position_steps(const ptz_ctx_t *ctx, int *pan, int *tilt, int *zoom);
+int ptz_set_position_steps(const ptz_ctx_t *ctx, int pan, int tilt, int zoom);
+/* Add issued steps to the stored position (clamped to the axis range) in one update. Skips the text
+   export, so it is cheap enough for every tick; ptz_export_position() catches the export up. */
+int ptz_add_position_steps(const ptz_ctx_t *ctx, int dpan, int dtilt);
+int ptz_export_position(const ptz_ctx_t *ctx);
+
+/* Cross-process motion ownership (ptz_state.c). Every motion command claims the axes for this context;
+   a context whose claim has been superseded drops its armed moves on its next ptz_tick(). */
+void ptz_motion_claim(ptz_ctx_t *ctx);
+
+/* Layout of TRACE_FILE (ptz_trace.c): a ring of one record per ptz_issue_motor() call, mapped shared by every
+   process using the library. Bump TRACE_VERSION when changing this. */
+struct ptz_trace_rec {
+    _Atomic uint32_t seq; /* index + 1 once written; anything else while being (re)written */
+    int32_t pid;
+    int64_t t_ns;    /* CLOCK_MONOTONIC when the command was issued */
+    uint32_t cmd;
+    int32_t axis;
+    int32_t step;    /* as sent to the driver (inversion applied) */
+    int32_t rep;
+    int32_t rc;
+    int32_t err;     /* errno when rc != 0 */
+    uint32_t lat_us; /* the whole call, including the spacing between repeats */
+    int32_t reserved;
+};
+
+struct ptz_trace_shm {
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t nrec;         /* a power of two in the live ring */
+    _Atomic uint32_t head; /* records ever claimed; the next one goes to rec[head % nrec] */
+    struct ptz_trace_rec rec[];
+};
+
+/* One trace record, copied out of the ring. */
+typedef struct {
+    int pid;
+    ptz_axis_t axis;
+    int64_t t_ns;
+    unsigned long cmd;
+    int step;
+    int rep;
+    int rc;
+    int err;
+    unsigned lat_us;
+} ptz_trace_entry_t;
+
+int ptz_trace_open(ptz_ctx_t *ctx);
+void ptz_trace_close(ptz_ctx_t *ctx);
+void ptz_trace_record(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, int step, int rep, int rc, int err,
+                      const struct timespec *t0);
+/* Read a trace file (the live ring or a ptz_trace_save() snapshot) into a malloc'ed array, oldest first.
+   Returns the number of records (0 with *out NULL when empty), or -1. */
+int ptz_trace_load(const char *path, ptz_trace_entry_t **out);
+int ptz_trace_save(const char *path, const ptz_trace_entry_t *e, int n);
+
+/* Layout of CMDQ_FILE (ptz_cmdq.c): a bounded MPSC ring of fixed-size commands. A slot free for position p has
+   seq == p, published seq == p + 1, being written p + 2, being skipped by the consumer p + 3, consumed
+   seq == p + nslots. Bump CMDQ_VERSION when changing this. */
+struct ptz_cmdq_rec {
+    _Atomic uint32_t seq;
+    uint16_t op;
+    uint16_t reserved;
+    _Atomic int32_t pid; /* producer writing the slot (seq == p + 2); 0 once the consumer has freed it */
+    int32_t arg;
+    int64_t t_ns; /* CLOCK_MONOTONIC when pushed */
+    double v[3];
+};
+
+struct ptz_cmdq_shm {
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;               /* a power of two */
+    _Atomic uint32_t consumer_gen; /* bumped by every ptz_cmdq_serve(): producers fetch the new doorbell */
+    _Atomic uint32_t tail;         /* producers: next position to claim */
+    _Atomic uint32_t head;         /* consumer: next position to apply */
+    _Atomic uint32_t full;         /* pushes refused on a full ring */
+    uint32_t reserved;
+    struct ptz_cmdq_rec slot[];
+};
+
+void ptz_cmdq_close_consumer(ptz_ctx_t *ctx);
+
+/* Client side of "cmdq-doorbell": the fd passed with the reply, or -1. */
+int ptz_ipc_request_fd(const char *path, const char *req);
+
+/* Logging levels: errors, info (moves/state changes), debug (per-ioctl motor lines).
+   LOG_LEVEL filters at runtime before anything is formatted; building with
+   -DPTZ_LOG_COMPILE_LEVEL=PTZ_LOG_LVL_INFO removes the debug lines from the binary. */
+#define PTZ_LOG_LVL_ERROR 0
+#define PTZ_LOG_LVL_INFO  1
+#define PTZ_LOG_LVL_DEBUG 2
+
+#ifndef PTZ_LOG_COMPILE_LEVEL
+#define PTZ_LOG_COMPILE_LEVEL PTZ_LOG_LVL_DEBUG
+#endif
+
+static inline bool ptz_log_enabled(const ptz_config_t *cfg, int level) {
+    return cfg && cfg->debug_log && level <= cfg->log_level;
+}
+
+#define PTZ_LOG(cfg, level, ...)                                                   \
+    do {                                                                           \
+        if ((level) <= PTZ_LOG_COMPILE_LEVEL && ptz_log_enabled((cfg), (level)))   \
+            ptz_log_write((cfg), (level), __VA_ARGS__);                            \
+    } while (0)
+#define PTZ_LOGE(cfg, ...) PTZ_LOG((cfg), PTZ_LOG_LVL_ERROR, __VA_ARGS__)
+#define PTZ_LOGD(cfg, ...) PTZ_LOG((cfg), PTZ_LOG_LVL_DEBUG, __VA_ARGS__)
+
+/* Instrumentation (ptz_stats.c): per-process counters and log2 latency histograms behind ptz_stats_format().
+   -DPTZ_STATS=0 compiles the hooks out. */
+#ifndef PTZ_STATS
+#define PTZ_STATS 1
+#endif
+#if PTZ_STATS
+#define PTZ_STAT(call) (call)
+#else
+#define PTZ_STAT(call) ((void)0)
+#endif
+
+#define PTZ_STATS_BUCKETS 21 /* <= 1us, <= 2us, ... <= 2^20us; then +Inf */
+
+typedef enum {
+    PTZ_STAT_MOVE, PTZ_STAT_STOP, PTZ_STAT_SET_SPEED, PTZ_STAT_TURN_MIDDLE, PTZ_STAT_GET_STATE, PTZ_STAT_OTHER,
+    PTZ_STAT_NCMD
+} ptz_stat_cmd_t;
+typedef enum { PTZ_STAT_LOOP_CONTINUOUS, PTZ_STAT_LOOP_MOVE, PTZ_STAT_NLOOP } ptz_stat_loop_t;
+
+ptz_stat_cmd_t ptz_stats_cmd(const ptz_config_t *cfg, unsigned long cmd);
+const char *ptz_stats_cmd_name(ptz_stat_cmd_t cmd);
+void ptz_stats_ioctl(ptz_axis_t axis, ptz_stat_cmd_t cmd, long long ns, bool failed);
+/* A tick that was due at `due` ran at `now`. */
+void ptz_stats_tick(ptz_stat_loop_t loop, const struct timespec *due, const struct timespec *now);
+void ptz_stats_catchup_skip(ptz_stat_loop_t loop);
+void ptz_stats_open_failure(ptz_axis_t axis);
+void ptz_stats_logged(size_t bytes);
+/* A command from the shared ring was applied `queued_ns` after it was pushed, or dropped as superseded. */
+void ptz_stats_cmdq(long long queued_ns, bool coalesced);
+
+/* Info-level line. */
 void ptz_log_line(const ptz_config_t *cfg, const char *fmt, ...);
+void ptz_log_write(const ptz_config_t *cfg, int level, const char *fmt, ...);
+void ptz_log_vwrite(const ptz_config_t *cfg, int level, const char *fmt, va_list ap);
+/* Flush buffered lines once the oldest is LOG_FLUSH_MS old. Cheap when nothing is buffered. */
+void ptz_log_poll(void);
+
+/* ptz_sleep_us() on the context's clock. */
+void ptz_ctx_sleep_us(const ptz_ctx_t *ctx, long us);
 
 /* Motor + continuous internals */
-int ptz_issue_motor(const ptz_config_t *cfg,
+int ptz_issue_motor(ptz_ctx_t *ctx,
                     ptz_axis_t axis,
                     const char *dir,
                     int step,
@@ -28,9 +220,90 @@ int ptz_issue_motor(const ptz_config_t *cfg,
                     bool do_log);
 
 /* Firmware extras (ak_motor.ko). */
-int ptz_motor_turn_middle(const ptz_config_t *cfg, ptz_axis_t axis, bool do_log);
+int ptz_motor_turn_middle(ptz_ctx_t *ctx, ptz_axis_t axis, bool do_log);
+/* Close the cached motor FDs (reopened lazily on the next command). */
+void ptz_motor_close(ptz_ctx_t *ctx);
+
+/* Reply of IOCTL_GET_STATE, all 32-bit. This is the layout ak_motor is assumed to use; it has not been checked
+   against the driver, and ak_motor's own 0x40046d43 encodes a 4-byte _IOW, so GET_STATE is off by default. */
+struct ptz_motor_msg {
+    int32_t pos;
+    int32_t speed_step;
+    int32_t steps_one_circle;
+    int32_t total_steps;
+    int32_t boundary_steps;
+    int32_t attach_timer;
+    int32_t status;
+};
+
+#define PTZ_MOTOR_RUNNING 0x1
+#define PTZ_MOTOR_AT_MIN  0x2
+#define PTZ_MOTOR_AT_MAX  0x4
+
+#define PTZ_MOTOR_BACKEND_SIM 3
+
+/* _IOR('m', 0x43, struct ptz_motor_msg): an IOCTL_GET_STATE that matches the reply above (the simulator's). */
+#define PTZ_MOTOR_GET_STATE_IOR 0x801c6d43UL
+
+/* IOCTL_GET_STATE (ptz_motor.c). All return -1 when the driver has no usable GET_STATE. */
+bool ptz_motor_has_state(const ptz_ctx_t *ctx, ptz_axis_t axis);
+int ptz_motor_get_state(ptz_ctx_t *ctx, ptz_axis_t axis, struct ptz_motor_msg *out);
+/* 1 = RUNNING, 0 = idle. */
+int ptz_motor_running(ptz_ctx_t *ctx, ptz_axis_t axis);
+/* Poll until the axis is idle (0), timeout_ms passes (1) or the state is unavailable (-1). */
+int ptz_motor_wait_idle(ptz_ctx_t *ctx, ptz_axis_t axis, int timeout_ms);
+/* Next GET_STATE poll interval after `us` (adaptive backoff, 2..32 ms; pass 0 to start). */
+long ptz_state_poll_next(long us);
+
+/* Simulated ak_motor for MOTOR_BACKEND=3 (ctx->sim). */
+void ptz_sim_init(ptz_ctx_t *ctx);
+int ptz_sim_ioctl(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, void *arg);
+
+/* Legacy /proc backend resolver (cached in ctx->proc). */
+int ptz_procfd_open(ptz_ctx_t *ctx, unsigned long fd_addr, char *dbg, size_t dbg_sz);
+bool ptz_procfd_stale(const ptz_ctx_t *ctx);
+void ptz_procfd_reset(ptz_ctx_t *ctx);
+
+void ptz_profile_init(ptz_profile_t *p, double dist, double vmax, double accel);
+/* Steps covered after t seconds (0..dist). */
+double ptz_profile_pos(const ptz_profile_t *p, double t);
+/* True when *_MAX_VEL and *_ACCEL are set for the axis; otherwise abs/rel use fixed chunks. */
+bool ptz_plan_enabled(const ptz_config_t *cfg, ptz_axis_t axis);
+int ptz_plan_period_ms(const ptz_config_t *cfg);
+/* One axis of a planned move: `steps` >= 0 (0 = axis stays put), sign = driver direction (+1/-1). */
+typedef struct {
+    int steps;
+    int sign;
+    ptz_dir_t dir;
+} ptz_plan_leg_t;
+
+/* Profile of a move of steps[] (ptz_axis order), in progress 0..1 shared by both axes. False if a moving axis
+   has no planner limits: the move then runs in fixed chunks. */
+bool ptz_plan_profile(const ptz_config_t *cfg, const int steps[2], ptz_profile_t *prof);
+/* How long a move of steps[] takes to issue: planned with `prof`, or in chunks when it is NULL. */
+long ptz_plan_travel_ms(const ptz_ctx_t *ctx, const int steps[2], const ptz_profile_t *prof);
+/* Start moving both axes (legs indexed by ptz_axis_t) towards position `to` (pan, tilt in steps; zoom).
+   `prof` is a profile from ptz_plan_profile() for these steps, or NULL to plan here. Preempts the current move.
+   ptz_tick() then drives it; ptz_move_wait() blocks until it is done. */
+int ptz_plan_start(ptz_ctx_t *ctx, const ptz_plan_leg_t leg[2], const int to[3], const ptz_profile_t *prof);
+int ptz_plan_tick(ptz_ctx_t *ctx);
+/* Abandon the current move, recording the position reached. Returns a mask (1 << axis) of axes that had
+   steps in flight; ptz_plan_preempt() also sends them IOCTL_STOP. */
+unsigned ptz_plan_cancel(ptz_ctx_t *ctx);
+void ptz_plan_preempt(ptz_ctx_t *ctx);
+
+/* Absolute move in degrees (the unit of presets). */
+int ptz_move_abs_deg_start(ptz_ctx_t *ctx, int pan_deg, int tilt_deg, int zoom);
+int ptz_move_abs_deg(ptz_ctx_t *ctx, int pan_deg, int tilt_deg, int zoom);
+
+/* Preset tour (ptz_tour.c). ptz_tour_tick() runs from ptz_tick() after the move tick, so it sees a leg that has
+   just arrived. ptz_tour_end() only forgets the tour (logging `why` unless NULL); the caller deals with the motors.
+   ptz_tour_replan() redoes the targets and legs after a config change, keeping the order. */
+int ptz_tour_tick(ptz_ctx_t *ctx);
+void ptz_tour_end(ptz_ctx_t *ctx, const char *why);
+void ptz_tour_replan(ptz_ctx_t *ctx);
 
-int ptz_continuous_arm(ptz_ctx_t *ctx, ptz_axis_t a, const char *dir, int step, int rep);
+int ptz_continuous_arm(ptz_ctx_t *ctx, ptz_axis_t a, ptz_dir_t dir, int step, int rep);
 void ptz_continuous_disarm(ptz_ctx_t *ctx, ptz_axis_t a);
 int ptz_continuous_tick(ptz_ctx_t *ctx);
 
@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Wire protocol (one request per connection):
+     client -> "<verb> [args]\n", then shuts down its write side (the line must arrive within
+               IPC_REQ_TIMEOUT_MS of connecting, so pipe it in rather than typing it)
+     server -> "<rc>\n[payload]", then closes
+   Keep it line-based so it can be driven with socat/nc for debugging. */
+
+#define IPC_REQ_TIMEOUT_MS   20 /* ptzd reads requests inline, between ticks: a slower client is dropped */
+#define IPC_REPLY_TIMEOUT_MS 10000 /* moves are answered once started; home can take a few seconds */
+
+static int fill_sockaddr(struct sockaddr_un *sa, const char *path) {
+    if (!path || !*path) return -1;
+    if (strlen(path) >= sizeof(sa->sun_path)) return -1;
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    snprintf(sa->sun_path, sizeof(sa->sun_path), "%s", path);
+    return 0;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read until EOF (or buffer full). Always NUL-terminates. */
+static ssize_t read_until_eof(int fd, char *buf, size_t buf_sz, int timeout_ms) {
+    size_t used = 0;
+    if (!buf_sz) return -1;
+
+    while (used + 1 < buf_sz) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        int pr = poll(&pfd, 1, timeout_ms);
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (pr == 0) break;
+
+        ssize_t n = read(fd, buf + used, buf_sz - 1 - used);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        used += (size_t)n;
+    }
+
+    buf[used] = '\0';
+    return (ssize_t)used;
+}
+
+/* Read one request line (up to the newline or EOF) within IPC_REQ_TIMEOUT_MS in total, so a client that
+   connects and stalls holds up ptz_tick() by at most that. Returns the length, or -1 on error or timeout. */
+static ssize_t read_request(int fd, char *buf, size_t buf_sz) {
+    struct timespec deadline;
+    (void)ptz_now_monotonic(&deadline);
+    deadline = ptz_timespec_add_us(deadline, IPC_REQ_TIMEOUT_MS * 1000L);
+
+    size_t used = 0;
+    while (used + 1 < buf_sz) {
+        struct timespec now;
+        (void)ptz_now_monotonic(&now);
+        if (ptz_timespec_ge(&now, &deadline)) return -1;
+        long left_ms = (long)(deadline.tv_sec - now.tv_sec) * 1000L +
+                       (deadline.tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        int pr = poll(&pfd, 1, (int)left_ms);
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (pr == 0) return -1;
+
+        ssize_t n = read(fd, buf + used, buf_sz - 1 - used);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        used += (size_t)n;
+        if (memchr(buf, '\n', used)) break;
+    }
+
+    buf[used] = '\0';
+    return (ssize_t)used;
+}
+
+int ptz_ipc_listen(const char *path) {
+    struct sockaddr_un sa;
+    if (fill_sockaddr(&sa, path) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    /* A stale socket from a crashed daemon would make bind() fail. */
+    (void)unlink(path);
+    ptz_mkdir_p_for_file(path);
+
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ptz_ipc_request(const char *path, const char *req, char *reply, size_t reply_sz) {
+    struct sockaddr_un sa;
+    if (!req || fill_sockaddr(&sa, path) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    int rc = -1;
+    if (write_all(fd, req, strlen(req)) == 0 && write_all(fd, "\n", 1) == 0) {
+        (void)shutdown(fd, SHUT_WR);
+
+        char tmp[64];
+        char *buf = (reply && reply_sz) ? reply : tmp;
+        size_t buf_sz = (reply && reply_sz) ? reply_sz : sizeof(tmp);
+        if (read_until_eof(fd, buf, buf_sz, IPC_REPLY_TIMEOUT_MS) > 0) rc = 0;
+    }
+
+    close(fd);
+    return rc;
+}
+
+/* Reply "0" with `pass` attached (SCM_RIGHTS), or "-1" if there is nothing to pass. */
+static int send_fd(int fd, int pass) {
+    if (pass < 0) return write_all(fd, "-1\n", 3);
+
+    char rc[] = "0\n";
+    struct iovec iov = { .iov_base = rc, .iov_len = 2 };
+    union {
+        struct cmsghdr h;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf) };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &pass, sizeof(int));
+
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    return (n == 2) ? 0 : -1;
+}
+
+int ptz_ipc_request_fd(const char *path, const char *req) {
+    struct sockaddr_un sa;
+    if (!req || fill_sockaddr(&sa, path) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int got = -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0 && write_all(fd, req, strlen(req)) == 0 &&
+        write_all(fd, "\n", 1) == 0) {
+        (void)shutdown(fd, SHUT_WR);
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        char rc[8];
+        struct iovec iov = { .iov_base = rc, .iov_len = sizeof(rc) - 1 };
+        union {
+            struct cmsghdr h;
+            char buf[CMSG_SPACE(sizeof(int))];
+        } ctl;
+        struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf) };
+        ssize_t n = -1;
+        if (poll(&pfd, 1, IPC_REPLY_TIMEOUT_MS) > 0) n = recvmsg(fd, &msg, 0);
+
+        struct cmsghdr *c = (n > 0) ? CMSG_FIRSTHDR(&msg) : NULL;
+        if (c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS && c->cmsg_len == CMSG_LEN(sizeof(int)))
+            memcpy(&got, CMSG_DATA(c), sizeof(int));
+        if (got >= 0) (void)fcntl(got, F_SETFD, FD_CLOEXEC);
+    }
+
+    close(fd);
+    return got;
+}
+
+int ptz_ipc_serve_one(ptz_ctx_t *ctx, int listen_fd) {
+    if (!ctx || listen_fd < 0) return -1;
+
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+
+    char req[256];
+    static char reply[PTZ_IPC_REPLY_MAX];
+    ssize_t n = read_request(fd, req, sizeof(req));
+    if (n < 0) PTZ_LOGD(&ctx->cfg, "ipc client sent no request within %dms, dropped", IPC_REQ_TIMEOUT_MS);
+    if (n > 0) {
+        req[strcspn(req, "\r\n")] = '\0';
+        /* Not a string reply, so not in ptz_ipc_handle(). */
+        if (strcmp(req, "cmdq-doorbell") == 0) {
+            (void)send_fd(fd, ctx->cmdq.efd);
+        } else {
+            (void)ptz_ipc_handle(ctx, req, reply, sizeof(reply));
+            (void)write_all(fd, reply, strlen(reply));
+        }
+    }
+
+    close(fd);
+    return 1;
+}
+
+static void parse_triple(const char *triple, double *x, double *y, double *z) {
+    *x = *y = *z = 0.0;
+    if (!triple) return;
+    (void)sscanf(triple, "%lf,%lf,%lf", x, y, z);
+}
+
+int ptz_ipc_handle(ptz_ctx_t *ctx, const char *req, char *reply, size_t reply_sz) {
+    if (!ctx || !req || !reply || !reply_sz) return -1;
+
+    char verb[32] = "";
+    char arg1[64] = "";
+    char arg2[64] = "";
+    (void)sscanf(req, "%31s %63s %63s", verb, arg1, arg2);
+
+    int rc = -1;
+    static char payload[PTZ_IPC_REPLY_MAX - 16];
+    payload[0] = '\0';
+
+    if (strcmp(verb, "move") == 0) {
+        rc = ptz_move_dir(ctx, arg1, arg2[0] ? arg2 : "0.5");
+    } else if (strcmp(verb, "velocity") == 0) {
+        double vx = 0.0, vy = 0.0;
+        (void)sscanf(arg1, "%lf,%lf", &vx, &vy);
+        rc = ptz_set_velocity(ctx, vx, vy);
+    } else if (strcmp(verb, "stop") == 0) {
+        rc = ptz_stop(ctx);
+    } else if (strcmp(verb, "home") == 0) {
+        rc = ptz_home(ctx);
+    } else if (strcmp(verb, "abs") == 0 || strcmp(verb, "rel") == 0) {
+        double x, y, z;
+        parse_triple(arg1, &x, &y, &z);
+        rc = (verb[0] == 'a') ? ptz_move_abs_start(ctx, x, y, z) : ptz_move_rel_start(ctx, x, y, z);
+    } else if (strcmp(verb, "preset") == 0) {
+        rc = ptz_preset_goto_start(ctx, ptz_parse_int(arg1, -1));
+    } else if (strcmp(verb, "preset-save") == 0) {
+        /* The name is the rest of the line and may contain spaces. */
+        const char *name = req + strlen(verb);
+        while (*name == ' ') name++;
+        int id = ptz_preset_save(ctx, 0, name);
+        rc = (id > 0) ? 0 : -1;
+        if (id > 0) snprintf(payload, sizeof(payload), "%d\n", id);
+    } else if (strcmp(verb, "preset-del") == 0) {
+        rc = ptz_preset_delete(ctx, ptz_parse_int(arg1, -1));
+    } else if (strcmp(verb, "preset-list") == 0) {
+        rc = ptz_format_presets(ctx, payload, sizeof(payload));
+    } else if (strcmp(verb, "get-position") == 0) {
+        int x, y, z;
+        rc = ptz_get_position(ctx, &x, &y, &z);
+        snprintf(payload, sizeof(payload), "%d,%d,%d\n", x, y, z);
+    } else if (strcmp(verb, "is-moving") == 0) {
+        rc = 0;
+        snprintf(payload, sizeof(payload), "%d\n", (ptz_is_moving(ctx) > 0) ? 1 : 0);
+    } else if (strcmp(verb, "stats") == 0) {
+        rc = (ptz_stats_format(payload, sizeof(payload)) < 0) ? -1 : 0;
+    } else if (strcmp(verb, "tour") == 0) {
+        /* A full list outgrows arg1. */
+        char list[200] = "", opt[8] = "";
+        (void)sscanf(req, "%*s %199s %7s", list, opt);
+        ptz_tour_spot_t spots[PTZ_TOUR_MAX];
+        int n = ptz_tour_parse(list, spots, PTZ_TOUR_MAX);
+        rc = (n > 0) ? ptz_tour_start(ctx, spots, n, strcmp(opt, "keep") != 0) : -1;
+    } else if (strcmp(verb, "tour-stop") == 0) {
+        ptz_tour_stop(ctx);
+        rc = 0;
+    } else if (strcmp(verb, "tour-status") == 0) {
+        ptz_tour_status_t st;
+        rc = (ptz_tour_status(ctx, &st) < 0) ? -1 : 0;
+        int used = snprintf(payload, sizeof(payload), "%d %d %ld %ld ", st.active ? 1 : 0, st.preset, st.cycles,
+                            st.cycle_ms);
+        for (int i = 0; i < st.n; i++)
+            used += snprintf(payload + used, sizeof(payload) - (size_t)used, "%s%d", i ? "," : "", st.order[i]);
+        snprintf(payload + used, sizeof(payload) - (size_t)used, "\n");
+    } else if (strcmp(verb, "move-status") == 0) {
+        ptz_move_status_t st;
+        rc = (ptz_move_status(ctx, &st) < 0) ? -1 : 0;
+        snprintf(payload, sizeof(payload), "%d %.3f %ld\n", st.active ? 1 : 0, st.progress, st.eta_ms);
+    } else {
+        ptz_log_line(&ctx->cfg, "ipc unknown request '%s'", req);
+    }
+
+    snprintf(reply, reply_sz, "%d\n%s", rc, payload);
+    return rc;
+}
+
+int ptz_ipc_parse_reply(char *reply, const char **payload) {
+    if (payload) *payload = "";
+    if (!reply) return -1;
+
+    char *nl = strchr(reply, '\n');
+    if (nl) {
+        *nl = '\0';
+        if (payload) *payload = nl + 1;
+    }
+    return ptz_parse_int(reply, -1);
+}
@@ -1,14 +1,21 @@
 #define _POSIX_C_SOURCE 200809L
 #include "ptz_internal.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
 const char *ptz_axis_name(ptz_axis_t a) { return (a == PTZ_AXIS_PAN) ? "pan" : "tilt"; }
 unsigned long ptz_axis_fd_addr(const ptz_config_t *c, ptz_axis_t a) { return (a == PTZ_AXIS_PAN) ? c->pan_fd_addr : c->tilt_fd_addr; }
 int ptz_axis_speed_step(const ptz_config_t *c, ptz_axis_t a) { return (a == PTZ_AXIS_PAN) ? c->pan_speed_step : c->tilt_speed_step; }
+int ptz_axis_max_vel(const ptz_config_t *c, ptz_axis_t a) { return (a == PTZ_AXIS_PAN) ? c->pan_max_vel : c->tilt_max_vel; }
+int ptz_axis_accel(const ptz_config_t *c, ptz_axis_t a) { return (a == PTZ_AXIS_PAN) ? c->pan_accel : c->tilt_accel; }
 
 void ptz_state_path(const ptz_config_t *cfg, const char *name, char *out, size_t out_sz) {
     snprintf(out, out_sz, "%s/%s", cfg->state_dir, name);
@@ -20,26 +27,168 @@ void ptz_ensure_state_dir(const ptz_config_t *cfg) {
     (void)mkdir(cfg->state_dir, 0755);
 }
 
-void ptz_log_line(const ptz_config_t *cfg, const char *fmt, ...) {
-    if (!cfg || !cfg->debug_log) return;
+/* Buffered logger.
+
+   LOG_FILE normally lives on the SD card, so lines are formatted into a preallocated ring and written
+   in batches: when half the ring is used, when the oldest buffered line is LOG_FLUSH_MS old (checked on
+   every write and from ptz_tick()), on errors, on ptz_ctx_close() and at exit. The library stays
+   thread-free, so "asynchronous" means deferred to one of those points rather than a writer thread.
+   One logger per process; the file is kept open between batches and rotated to LOG_FILE.1 once it
+   exceeds LOG_MAX_KB. */
+
+#define LOG_RING_SZ      8192
+#define LOG_FLUSH_BYTES  (LOG_RING_SZ / 2)
+#define LOG_LINE_MAX     512
+
+static struct {
+    char ring[LOG_RING_SZ];
+    size_t head;            /* total bytes ever buffered */
+    size_t tail;            /* total bytes ever written out */
+    struct timespec first;  /* when the oldest unflushed line was buffered */
+
+    int fd;
+    char path[256];
+    off_t size;
+    long max_bytes;
+    int flush_ms;
+    bool atexit_done;
+
+    time_t ts_sec;          /* timestamp prefix is re-rendered only when the second changes */
+    char ts[32];
+    size_t ts_len;
+} g_log = { .fd = -1 };
+
+static void log_open(void) {
+    ptz_mkdir_p_for_file(g_log.path);
+    g_log.fd = open(g_log.path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (g_log.fd < 0) return;
+    (void)fcntl(g_log.fd, F_SETFD, FD_CLOEXEC);
+
+    struct stat st;
+    g_log.size = (fstat(g_log.fd, &st) == 0) ? st.st_size : 0;
+}
+
+static void log_rotate(void) {
+    char old[sizeof(g_log.path) + 2];
+    snprintf(old, sizeof(old), "%s.1", g_log.path);
+
+    close(g_log.fd);
+    g_log.fd = -1;
+    (void)rename(g_log.path, old);
+    log_open();
+}
+
+void ptz_log_flush(void) {
+    size_t pending = g_log.head - g_log.tail;
+    if (!pending || !g_log.path[0]) return;
+
+    if (g_log.fd < 0) log_open();
+    if (g_log.fd >= 0 && g_log.max_bytes > 0 && g_log.size + (off_t)pending > g_log.max_bytes) log_rotate();
+
+    if (g_log.fd >= 0) {
+        size_t off = g_log.tail % LOG_RING_SZ;
+        size_t first = LOG_RING_SZ - off;
+        if (first > pending) first = pending;
+
+        struct iovec iov[2] = {
+            { .iov_base = g_log.ring + off, .iov_len = first },
+            { .iov_base = g_log.ring, .iov_len = pending - first },
+        };
+        ssize_t n;
+        do {
+            n = writev(g_log.fd, iov, (pending > first) ? 2 : 1);
+        } while (n < 0 && errno == EINTR);
+        if (n > 0) g_log.size += n;
+    }
+
+    /* Drop the batch even if the SD card refused it; never block motion on logging. */
+    g_log.tail = g_log.head;
+}
+
+void ptz_log_poll(void) {
+    if (g_log.head == g_log.tail) return;
 
-    ptz_mkdir_p_for_file(cfg->log_file);
-    FILE *f = fopen(cfg->log_file, "a");
-    if (!f) return;
+    struct timespec now;
+    if (ptz_now_monotonic(&now) != 0) return;
+
+    struct timespec due = ptz_timespec_add_us(g_log.first, (long)g_log.flush_ms * 1000L);
+    if (ptz_timespec_ge(&now, &due)) ptz_log_flush();
+}
+
+static void log_append(const char *s, size_t len) {
+    if (len > LOG_RING_SZ) len = LOG_RING_SZ;
+    PTZ_STAT(ptz_stats_logged(len));
+    if (LOG_RING_SZ - (g_log.head - g_log.tail) < len) ptz_log_flush();
+
+    size_t off = g_log.head % LOG_RING_SZ;
+    size_t first = LOG_RING_SZ - off;
+    if (first > len) first = len;
+    memcpy(g_log.ring + off, s, first);
+    memcpy(g_log.ring, s + first, len - first);
+    g_log.head += len;
+}
+
+static void log_configure(const ptz_config_t *cfg) {
+    if (strcmp(g_log.path, cfg->log_file) != 0) {
+        ptz_log_flush();
+        if (g_log.fd >= 0) close(g_log.fd);
+        g_log.fd = -1;
+        snprintf(g_log.path, sizeof(g_log.path), "%s", cfg->log_file);
+    }
+    g_log.max_bytes = (long)cfg->log_max_kb * 1024L;
+    g_log.flush_ms = (cfg->log_flush_ms > 0) ? cfg->log_flush_ms : 0;
+
+    if (!g_log.atexit_done) {
+        g_log.atexit_done = true;
+        (void)atexit(ptz_log_flush);
+    }
+}
+
+void ptz_log_vwrite(const ptz_config_t *cfg, int level, const char *fmt, va_list ap) {
+    if (!ptz_log_enabled(cfg, level)) return;
+
+    log_configure(cfg);
 
     time_t now = time(NULL);
-    struct tm tm_now;
-    localtime_r(&now, &tm_now);
+    if (now != g_log.ts_sec || !g_log.ts_len) {
+        struct tm tm_now;
+        localtime_r(&now, &tm_now);
+        g_log.ts_len = strftime(g_log.ts, sizeof(g_log.ts), "[%Y-%m-%dT%H:%M:%S] ", &tm_now);
+        g_log.ts_sec = now;
+    }
 
-    char ts[64];
-    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm_now);
-    fprintf(f, "[%s] ", ts);
+    char line[LOG_LINE_MAX];
+    memcpy(line, g_log.ts, g_log.ts_len);
+    int n = vsnprintf(line + g_log.ts_len, sizeof(line) - g_log.ts_len - 1, fmt, ap);
+    if (n < 0) return;
 
+    size_t len = g_log.ts_len + (size_t)n;
+    if (len > sizeof(line) - 2) len = sizeof(line) - 2;
+    line[len++] = '\n';
+
+    if (g_log.head == g_log.tail && ptz_now_monotonic(&g_log.first) != 0) {
+        g_log.first.tv_sec = 0;
+        g_log.first.tv_nsec = 0;
+    }
+    log_append(line, len);
+
+    if (level <= PTZ_LOG_LVL_ERROR || !g_log.flush_ms || g_log.head - g_log.tail >= LOG_FLUSH_BYTES) {
+        ptz_log_flush();
+    } else {
+        ptz_log_poll();
+    }
+}
+
+void ptz_log_write(const ptz_config_t *cfg, int level, const char *fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    vfprintf(f, fmt, ap);
+    ptz_log_vwrite(cfg, level, fmt, ap);
     va_end(ap);
+}
 
-    fputc('\n', f);
-    fclose(f);
+void ptz_log_line(const ptz_config_t *cfg, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    ptz_log_vwrite(cfg, PTZ_LOG_LVL_INFO, fmt, ap);
+    va_end(ap);
 }
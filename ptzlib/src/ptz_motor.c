@@ -1,66 +1,14 @@
 #define _POSIX_C_SOURCE 200809L
 #include "ptz_internal.h"
 
-#include <ctype.h>
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
-static pid_t find_pid_by_name(const char *name) {
-    DIR *d = opendir("/proc");
-    if (!d) return -1;
-
-    struct dirent *de;
-    while ((de = readdir(d))) {
-        if (!isdigit((unsigned char)de->d_name[0])) continue;
-
-        pid_t pid = (pid_t)atoi(de->d_name);
-
-        char comm_path[256];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", (int)pid);
-
-        FILE *f = fopen(comm_path, "r");
-        if (!f) continue;
-
-        char comm[128];
-        if (!fgets(comm, sizeof(comm), f)) {
-            fclose(f);
-            continue;
-        }
-        fclose(f);
-
-        comm[strcspn(comm, "\r\n")] = '\0';
-        if (strcmp(comm, name) == 0) {
-            closedir(d);
-            return pid;
-        }
-    }
-
-    closedir(d);
-    return -1;
-}
-
-static int read_motor_fd(pid_t pid, unsigned long addr) {
-    char mem_path[256];
-    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
-
-    int memfd = open(mem_path, O_RDONLY);
-    if (memfd < 0) return -1;
-
-    uint32_t mfd = 0;
-    ssize_t n = pread(memfd, &mfd, sizeof(mfd), (off_t)addr);
-    close(memfd);
-
-    if (n != (ssize_t)sizeof(mfd)) return -1;
-    return (int)mfd;
-}
-
 static const char *axis_dev_path(const ptz_config_t *cfg, ptz_axis_t axis) {
     if (!cfg) return NULL;
     if (axis == PTZ_AXIS_PAN) return (cfg->pan_dev[0] ? cfg->pan_dev : "/dev/motor0");
@@ -76,13 +24,16 @@ static int devnode_exists(const char *p) {
      - /dev/motorX (preferred on firmwares with ak_motor.ko), or
      - legacy /proc/PID/fd indirection.
 
-   Returns an open FD on success (caller must close), or -1.
+   Returns an open FD on success (caller owns it), or -1.
 */
-static int open_motor_fd(const ptz_config_t *cfg, ptz_axis_t axis, unsigned long fd_addr, char *dbg, size_t dbg_sz) {
+static int open_motor_fd(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long fd_addr, bool *borrowed,
+                         char *dbg, size_t dbg_sz) {
     if (dbg && dbg_sz) dbg[0] = '\0';
+    *borrowed = false;
 
+    const ptz_config_t *cfg = &ctx->cfg;
     const char *dev = axis_dev_path(cfg, axis);
-    int backend = cfg ? cfg->motor_backend : 0;
+    int backend = cfg->motor_backend;
 
     /* Decide backend.
        AUTO: if /dev node exists use it; otherwise fall back to procfd if we have an addr.
@@ -99,96 +50,244 @@ static int open_motor_fd(const ptz_config_t *cfg, ptz_axis_t axis, unsigned long
     }
 
     if (!try_proc) return -1;
-    if (!cfg) return -1;
-    if (fd_addr == 0) return -1;
 
-    pid_t pid = (cfg->anyka_pid > 1) ? (pid_t)cfg->anyka_pid : find_pid_by_name(cfg->anyka_proc);
-    if (pid < 0) return -1;
+    int fd = ptz_procfd_open(ctx, fd_addr, dbg, dbg_sz);
+    if (fd >= 0) *borrowed = true;
+    return fd;
+}
+
+static void motor_drop_fd(ptz_ctx_t *ctx, ptz_axis_t axis) {
+    if (ctx->motor[axis].fd >= 0) close(ctx->motor[axis].fd);
+    ctx->motor[axis].fd = -1;
+}
+
+static int motor_fd(ptz_ctx_t *ctx, ptz_axis_t axis) {
+    if (ctx->motor[axis].fd >= 0 && ctx->motor[axis].borrowed && ptz_procfd_stale(ctx)) {
+        /* anyka_ipc restarted: both borrowed FDs refer to the old instance. */
+        ptz_log_line(&ctx->cfg, "motor %s pid=%d went away, re-resolving", ctx->cfg.anyka_proc, ctx->proc.pid);
+        motor_drop_fd(ctx, PTZ_AXIS_PAN);
+        motor_drop_fd(ctx, PTZ_AXIS_TILT);
+        ptz_procfd_reset(ctx);
+    }
+    if (ctx->motor[axis].fd >= 0) return ctx->motor[axis].fd;
+
+    int fd = open_motor_fd(ctx, axis, ptz_axis_fd_addr(&ctx->cfg, axis), &ctx->motor[axis].borrowed,
+                           ctx->motor[axis].via, sizeof(ctx->motor[axis].via));
+    if (fd >= 0) (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    else PTZ_STAT(ptz_stats_open_failure(axis));
+    ctx->motor[axis].fd = fd;
+    return fd;
+}
+
+/* True if `axis` can take commands (opening the FD if needed). */
+static bool motor_ready(ptz_ctx_t *ctx, ptz_axis_t axis) {
+    if (ctx->cfg.motor_backend == PTZ_MOTOR_BACKEND_SIM) {
+        snprintf(ctx->motor[axis].via, sizeof(ctx->motor[axis].via), "sim");
+        return true;
+    }
+    return motor_fd(ctx, axis) >= 0;
+}
 
-    int mfd = read_motor_fd(pid, fd_addr);
-    if (mfd <= 0) return -1;
+/* ioctl on the cached FD. If the driver was reloaded or the node vanished underneath us,
+   reopen once and retry so callers never see a stale descriptor. */
+static int motor_ioctl_once(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, void *arg) {
+    if (ctx->cfg.motor_backend == PTZ_MOTOR_BACKEND_SIM) return ptz_sim_ioctl(ctx, axis, cmd, arg);
 
-    char fd_path[256];
-    snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd/%d", (int)pid, mfd);
+    int fd = motor_fd(ctx, axis);
+    if (fd < 0) return -1;
 
-    int devfd = open(fd_path, O_RDWR);
-    if (devfd < 0) return -1;
+    errno = 0;
+    int rc = ioctl(fd, cmd, arg);
+    if (rc != 0 && (errno == EBADF || errno == ENODEV)) {
+        motor_drop_fd(ctx, axis);
+        fd = motor_fd(ctx, axis);
+        if (fd < 0) return -1;
+        errno = 0;
+        rc = ioctl(fd, cmd, arg);
+    }
+    return rc;
+}
 
-    if (dbg && dbg_sz) snprintf(dbg, dbg_sz, "proc:%s (pid=%d mfd=%d)", fd_path, (int)pid, mfd);
-    return devfd;
+/* motor_ioctl_once(), timed into the ioctl latency histogram. */
+static int motor_ioctl(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, void *arg) {
+#if PTZ_STATS
+    struct timespec t0, t1;
+    (void)ptz_ctx_now(ctx, &t0);
+    int rc = motor_ioctl_once(ctx, axis, cmd, arg);
+    int saved = errno;
+    (void)ptz_ctx_now(ctx, &t1);
+    ptz_stats_ioctl(axis, ptz_stats_cmd(&ctx->cfg, cmd),
+                    (long long)(t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec), rc != 0);
+    errno = saved;
+    return rc;
+#else
+    return motor_ioctl_once(ctx, axis, cmd, arg);
+#endif
 }
 
-int ptz_issue_motor(const ptz_config_t *cfg,
+static void log_open_failure(const ptz_ctx_t *ctx, ptz_axis_t axis, const char *what) {
+    const ptz_config_t *cfg = &ctx->cfg;
+    PTZ_LOGE(cfg,
+             "ERROR open motor failed%s axis=%s backend=%d dev=%s fd_addr=0x%lx errno=%d",
+             what, ptz_axis_name(axis), cfg->motor_backend,
+             axis_dev_path(cfg, axis) ? axis_dev_path(cfg, axis) : "",
+             ptz_axis_fd_addr(cfg, axis), errno);
+}
+
+void ptz_motor_close(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+    motor_drop_fd(ctx, PTZ_AXIS_PAN);
+    motor_drop_fd(ctx, PTZ_AXIS_TILT);
+    ptz_procfd_reset(ctx);
+}
+
+/* GET_STATE polling starts short and doubles: a command that is nearly done is noticed quickly,
+   a long one is not polled every millisecond. */
+#define STATE_POLL_MIN_US    2000L
+#define STATE_POLL_MAX_US    32000L
+#define REPEAT_GAP_MS        10 /* fixed spacing between repeats when GET_STATE can't tell */
+
+long ptz_state_poll_next(long us) {
+    if (us < STATE_POLL_MIN_US) return STATE_POLL_MIN_US;
+    us *= 2;
+    return (us > STATE_POLL_MAX_US) ? STATE_POLL_MAX_US : us;
+}
+
+bool ptz_motor_has_state(const ptz_ctx_t *ctx, ptz_axis_t axis) {
+    return ctx && ctx->cfg.ioctl_get_state != 0 && !ctx->motor[axis].no_state;
+}
+
+int ptz_motor_get_state(ptz_ctx_t *ctx, ptz_axis_t axis, struct ptz_motor_msg *out) {
+    if (!ctx || !out || !ptz_motor_has_state(ctx, axis)) return -1;
+    if (!motor_ready(ctx, axis)) return -1;
+
+    /* Only pass our buffer to a command that says it writes back exactly that much. */
+    unsigned long cmd = ctx->cfg.ioctl_get_state;
+    if (!(_IOC_DIR(cmd) & _IOC_READ) || _IOC_SIZE(cmd) != sizeof(*out)) {
+        ctx->motor[axis].no_state = true;
+        ptz_log_line(&ctx->cfg, "motor axis=%s IOCTL_GET_STATE=0x%lx is not a %zu-byte read, pacing by time",
+                     ptz_axis_name(axis), cmd, sizeof(*out));
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    errno = 0;
+    if (motor_ioctl(ctx, axis, cmd, out) == 0) return 0;
+
+    if (errno == ENOTTY || errno == EINVAL || errno == ENOSYS) {
+        /* The driver does not know the command: stop asking and fall back to timing. */
+        ctx->motor[axis].no_state = true;
+        ptz_log_line(&ctx->cfg, "motor axis=%s has no GET_STATE (cmd=0x%lx errno=%d), pacing by time",
+                     ptz_axis_name(axis), ctx->cfg.ioctl_get_state, errno);
+    }
+    return -1;
+}
+
+int ptz_motor_running(ptz_ctx_t *ctx, ptz_axis_t axis) {
+    struct ptz_motor_msg msg;
+    if (ptz_motor_get_state(ctx, axis, &msg) != 0) return -1;
+    return (msg.status & PTZ_MOTOR_RUNNING) ? 1 : 0;
+}
+
+/* Poll until the axis is (running == want) (0), timeout_ms passes (1) or the state is unavailable (-1). */
+static int wait_running(ptz_ctx_t *ctx, ptz_axis_t axis, int want, int timeout_ms) {
+    struct timespec now, deadline;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+    deadline = ptz_timespec_add_us(now, (long)timeout_ms * 1000L);
+
+    long poll_us = 0;
+    for (;;) {
+        int running = ptz_motor_running(ctx, axis);
+        if (running < 0) return -1;
+        if (running == want) return 0;
+
+        if (ptz_ctx_now(ctx, &now) != 0 || ptz_timespec_ge(&now, &deadline)) return 1;
+        poll_us = ptz_state_poll_next(poll_us);
+        struct timespec due = ptz_timespec_add_us(now, poll_us);
+        ptz_ctx_sleep_until(ctx, ptz_timespec_ge(&due, &deadline) ? &deadline : &due);
+    }
+}
+
+int ptz_motor_wait_idle(ptz_ctx_t *ctx, ptz_axis_t axis, int timeout_ms) {
+    return wait_running(ctx, axis, 0, timeout_ms);
+}
+
+/* Spacing between repeats of one command. A MOVE repeat goes out as soon as GET_STATE shows the driver
+   has picked up the previous one, waiting at most the old fixed gap; without GET_STATE (or for other
+   commands) the fixed gap. Waiting for completion instead would change what STEP_REPEAT means on
+   drivers where a MOVE replaces the target still in flight. */
+static void pace_repeat(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd) {
+    if (cmd == ctx->cfg.ioctl_move && wait_running(ctx, axis, 1, REPEAT_GAP_MS) >= 0) return;
+    ptz_ctx_sleep_us(ctx, REPEAT_GAP_MS * 1000L);
+}
+
+int ptz_issue_motor(ptz_ctx_t *ctx,
                     ptz_axis_t axis,
                     const char *dir,
                     int step,
                     int rep,
                     unsigned long cmd,
                     bool do_log) {
+    if (!ctx) return -1;
+    const ptz_config_t *cfg = &ctx->cfg;
     unsigned long fd_addr = ptz_axis_fd_addr(cfg, axis);
 
-    char dbg[512];
-    int devfd = open_motor_fd(cfg, axis, fd_addr, dbg, sizeof(dbg));
-    if (devfd < 0) {
-        ptz_log_line(cfg,
-                     "ERROR open motor failed axis=%s backend=%d dev=%s fd_addr=0x%lx errno=%d",
-                     ptz_axis_name(axis), cfg ? cfg->motor_backend : -1,
-                     axis_dev_path(cfg, axis) ? axis_dev_path(cfg, axis) : "",
-                     fd_addr, errno);
+    if (!motor_ready(ctx, axis)) {
+        log_open_failure(ctx, axis, "");
         return -1;
     }
 
     if (rep < 1) rep = 1;
 
+    struct timespec t0;
+    if (ctx->trace) (void)ptz_ctx_now(ctx, &t0);
+
     int rc = 0;
     int32_t step32 = (int32_t)step;
     errno = 0;
     for (int i = 0; i < rep; i++) {
-        rc = ioctl(devfd, cmd, &step32);
+        if (i) pace_repeat(ctx, axis, cmd); /* between repeats only; a single command returns at once */
+        rc = motor_ioctl(ctx, axis, cmd, &step32);
         if (rc) break;
-        ptz_sleep_us(10000);
+    }
+
+    if (ctx->trace) {
+        int saved = errno;
+        ptz_trace_record(ctx, axis, cmd, step, rep, rc, saved, &t0);
+        errno = saved;
     }
 
     if (do_log) {
-        ptz_log_line(cfg,
-                     "motor axis=%s via=%s dir=%s step=%d rep=%d cmd=0x%lx fd_addr=0x%lx rc=%d errno=%d",
-                     ptz_axis_name(axis), dbg,
-                     dir ? dir : "", step, rep, cmd, fd_addr, rc, errno);
+        PTZ_LOGD(cfg,
+                 "motor axis=%s via=%s dir=%s step=%d rep=%d cmd=0x%lx fd_addr=0x%lx rc=%d errno=%d",
+                 ptz_axis_name(axis), ctx->motor[axis].via,
+                 dir ? dir : "", step, rep, cmd, fd_addr, rc, errno);
     }
 
-    close(devfd);
     return rc;
 }
 
-int ptz_motor_turn_middle(const ptz_config_t *cfg, ptz_axis_t axis, bool do_log) {
-    if (!cfg) return -1;
+int ptz_motor_turn_middle(ptz_ctx_t *ctx, ptz_axis_t axis, bool do_log) {
+    if (!ctx) return -1;
+    const ptz_config_t *cfg = &ctx->cfg;
     if (cfg->ioctl_turn_middle == 0) return -1;
 
-    unsigned long fd_addr = ptz_axis_fd_addr(cfg, axis);
-    char dbg[512];
-    int devfd = open_motor_fd(cfg, axis, fd_addr, dbg, sizeof(dbg));
-    if (devfd < 0) {
-        ptz_log_line(cfg,
-                     "ERROR open motor failed (turn_middle) axis=%s backend=%d dev=%s fd_addr=0x%lx errno=%d",
-                     ptz_axis_name(axis), cfg->motor_backend,
-                     axis_dev_path(cfg, axis) ? axis_dev_path(cfg, axis) : "",
-                     fd_addr, errno);
+    if (!motor_ready(ctx, axis)) {
+        log_open_failure(ctx, axis, " (turn_middle)");
         return -1;
     }
 
     /* anyka_ipc passes an 8-byte user buffer for this ioctl on the observed firmware.
        We do the same to stay ABI-compatible and ignore returned data. */
     uint64_t buf = 0;
-    errno = 0;
-    int rc = ioctl(devfd, cfg->ioctl_turn_middle, &buf);
+    int rc = motor_ioctl(ctx, axis, cfg->ioctl_turn_middle, &buf);
 
     if (do_log) {
-        ptz_log_line(cfg,
-                     "motor axis=%s via=%s turn_middle cmd=0x%lx fd_addr=0x%lx rc=%d errno=%d out=0x%llx",
-                     ptz_axis_name(axis), dbg, cfg->ioctl_turn_middle, fd_addr,
-                     rc, errno, (unsigned long long)buf);
+        PTZ_LOGD(cfg,
+                 "motor axis=%s via=%s turn_middle cmd=0x%lx fd_addr=0x%lx rc=%d errno=%d out=0x%llx",
+                 ptz_axis_name(axis), ctx->motor[axis].via, cfg->ioctl_turn_middle,
+                 ptz_axis_fd_addr(cfg, axis), rc, errno, (unsigned long long)buf);
     }
 
-    close(devfd);
     return rc;
 }
@@ -0,0 +1,438 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Trajectory planner for abs/rel/preset moves.
+
+   A move of N steps follows a trapezoidal velocity profile: accelerate at *_ACCEL up to *_MAX_VEL,
+   cruise, decelerate (a triangle when N is too short to reach full speed). Every ABSREL_INTERVAL_MS
+   the planner issues one MOVE covering exactly the steps the profile advances in that period, preceded
+   (with SET_SPEED_EACH_MOVE) by a SET_SPEED so the driver spreads them over the period. That assumes
+   IOCTL_SET_SPEED is in steps/s, which is unverified on real drivers, so the planner is off unless the
+   PAN/TILT _MAX_VEL and _ACCEL keys are set.
+   Steps come from the rounded cumulative profile, so they always sum to N. Pan and tilt run in
+   the same periods, interleaved, and are time-scaled to arrive together.
+
+   The profile is planned at PLAN_HEADROOM of *_MAX_VEL and each segment asks the driver to finish
+   within that fraction of the period, so ioctl latency never leaves steps queued into the next one.
+
+   A move is a state machine in ctx->move, like the continuous moves in ctx->cont: ptz_plan_start()
+   sets it up and returns, ptz_tick() issues each period once it is due, and a new move or ptz_stop()
+   preempts it. Without planner limits the same machine issues the old fixed ABSREL_CHUNK_STEPS
+   pieces, on both axes at once and scaled so they arrive together; each piece is sent once GET_STATE
+   reports the previous one done (every ABSREL_INTERVAL_MS when the driver has no GET_STATE). A move completes when both motors
+   report idle. */
+
+#define PLAN_PERIOD_MIN_MS 10
+#define PLAN_HEADROOM      0.9
+#define PLAN_SETTLE_MAX_MS 2000 /* give up waiting for GET_STATE idle after the last command or piece */
+
+void ptz_profile_init(ptz_profile_t *p, double dist, double vmax, double accel) {
+    p->dist = fabs(dist);
+    p->accel = accel;
+    p->vpeak = vmax;
+    p->t_acc = vmax / accel;
+
+    double d_acc = 0.5 * accel * p->t_acc * p->t_acc;
+    if (2.0 * d_acc >= p->dist) {
+        /* Triangle: never reaches vmax. */
+        p->t_acc = sqrt(p->dist / accel);
+        p->vpeak = accel * p->t_acc;
+        p->t_cruise = 0.0;
+    } else {
+        p->t_cruise = (p->dist - 2.0 * d_acc) / vmax;
+    }
+    p->total = 2.0 * p->t_acc + p->t_cruise;
+}
+
+double ptz_profile_pos(const ptz_profile_t *p, double t) {
+    if (t <= 0.0) return 0.0;
+    if (t >= p->total) return p->dist;
+
+    if (t < p->t_acc) return 0.5 * p->accel * t * t;
+
+    double d_acc = 0.5 * p->accel * p->t_acc * p->t_acc;
+    if (t < p->t_acc + p->t_cruise) return d_acc + p->vpeak * (t - p->t_acc);
+
+    double td = p->total - t;
+    return p->dist - 0.5 * p->accel * td * td;
+}
+
+bool ptz_plan_enabled(const ptz_config_t *cfg, ptz_axis_t axis) {
+    return ptz_axis_max_vel(cfg, axis) > 0 && ptz_axis_accel(cfg, axis) > 0;
+}
+
+int ptz_plan_period_ms(const ptz_config_t *cfg) {
+    return (cfg->absrel_interval_ms > PLAN_PERIOD_MIN_MS) ? cfg->absrel_interval_ms : PLAN_PERIOD_MIN_MS;
+}
+
+static double elapsed_s(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static long long elapsed_ns(const struct timespec *from, const struct timespec *to) {
+    return (long long)(to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+}
+
+unsigned ptz_plan_cancel(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->move.active) return 0;
+    ctx->move.active = false;
+    ctx->move.preempted = true;
+
+    /* The stored position already follows the issued steps; only the text export lags. */
+    unsigned moving = 0;
+    for (int a = 0; a < 2; a++) {
+        if (ctx->move.steps[a] > 0 && ctx->move.done[a] > 0) moving |= 1u << a;
+    }
+    (void)ptz_export_position(ctx);
+
+    int p = 0, t = 0, z = 0;
+    (void)ptz_get_position_steps(ctx, &p, &t, &z);
+    ptz_log_line(&ctx->cfg, "move preempted pos=%d,%d,%d steps=%d,%d", ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, p),
+                 ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, t), z, p, t);
+    return moving;
+}
+
+/* Account `delta` issued steps of axis `a` to the shared position, so other processes see the head move
+   and a preempted move leaves the position where it got to. */
+static void plan_account(ptz_ctx_t *ctx, ptz_axis_t a, int delta) {
+    int moved = ptz_drive_steps(ctx, a, ctx->move.sign[a]) * delta;
+    (void)ptz_add_position_steps(ctx, (a == PTZ_AXIS_PAN) ? moved : 0, (a == PTZ_AXIS_TILT) ? moved : 0);
+}
+
+void ptz_plan_preempt(ptz_ctx_t *ctx) {
+    unsigned moving = ptz_plan_cancel(ctx);
+    for (int a = 0; a < 2; a++) {
+        if (moving & (1u << a)) (void)ptz_issue_motor(ctx, (ptz_axis_t)a, "", 0, 1, ctx->cfg.ioctl_stop, false);
+    }
+}
+
+bool ptz_plan_profile(const ptz_config_t *cfg, const int steps[2], ptz_profile_t *prof) {
+    for (int a = 0; a < 2; a++) {
+        if (steps[a] > 0 && !ptz_plan_enabled(cfg, (ptz_axis_t)a)) return false;
+    }
+
+    /* Plan in normalized progress u = 0..1 shared by both axes, with the tightest per-axis limits
+       (vmax_a / steps_a, accel_a / steps_a). Each axis then sits at steps_a * u(t): both start and
+       arrive together and the path is a straight line in step space. */
+    double vmax_u = 0.0, accel_u = 0.0;
+    for (int a = 0; a < 2; a++) {
+        if (steps[a] <= 0) continue;
+        double v = ptz_axis_max_vel(cfg, (ptz_axis_t)a) * PLAN_HEADROOM / steps[a];
+        double acc = (double)ptz_axis_accel(cfg, (ptz_axis_t)a) / steps[a];
+        if (vmax_u == 0.0 || v < vmax_u) vmax_u = v;
+        if (accel_u == 0.0 || acc < accel_u) accel_u = acc;
+    }
+    if (vmax_u == 0.0) return false;
+    ptz_profile_init(prof, 1.0, vmax_u, accel_u);
+    return true;
+}
+
+long ptz_plan_travel_ms(const ptz_ctx_t *ctx, const int steps[2], const ptz_profile_t *prof) {
+    const ptz_config_t *cfg = &ctx->cfg;
+    if (prof) {
+        /* Whole periods: the last segment is issued at the first period boundary past the profile's end. */
+        long period_ms = ptz_plan_period_ms(cfg);
+        long ms = (long)ceil(prof->total * 1000.0);
+        return (ms + period_ms - 1) / period_ms * period_ms;
+    }
+
+    /* Chunks, pan then tilt, paced as plan_tick_chunks() paces them. */
+    int chunk = (cfg->absrel_chunk_steps > 0) ? cfg->absrel_chunk_steps : 1;
+    long interval_ms = (cfg->absrel_interval_ms > 0) ? cfg->absrel_interval_ms : 0;
+    long ms = 0;
+    for (int a = 0; a < 2; a++) {
+        if (steps[a] <= 0) continue;
+        int speed = ptz_axis_speed_step(cfg, (ptz_axis_t)a);
+        if (ptz_motor_has_state(ctx, (ptz_axis_t)a) && speed > 0) ms += (long)steps[a] * 1000L / speed;
+        else ms += (long)((steps[a] + chunk - 1) / chunk) * interval_ms;
+    }
+    return ms;
+}
+
+int ptz_plan_start(ptz_ctx_t *ctx, const ptz_plan_leg_t leg[2], const int to[3], const ptz_profile_t *prof) {
+    if (!ctx) return -1;
+    const ptz_config_t *cfg = &ctx->cfg;
+
+    /* The previous move stops where it got to; this one starts from rest. */
+    ptz_plan_preempt(ctx);
+    ptz_motion_claim(ctx);
+
+    int from[3];
+    (void)ptz_get_position_steps(ctx, &from[0], &from[1], &from[2]);
+
+    unsigned id = ctx->move.id + 1u;
+    memset(&ctx->move, 0, sizeof(ctx->move));
+    ctx->move.id = id;
+    for (int i = 0; i < 3; i++) {
+        ctx->move.from[i] = from[i];
+        ctx->move.to[i] = to[i];
+    }
+    for (int a = 0; a < 2; a++) {
+        ctx->move.steps[a] = (leg[a].steps > 0) ? leg[a].steps : 0;
+        ctx->move.sign[a] = leg[a].sign;
+        ctx->move.speed[a] = -1;
+        ctx->move.dir[a] = leg[a].dir;
+    }
+
+    if (!ctx->move.steps[0] && !ctx->move.steps[1]) {
+        (void)ptz_set_position_steps(ctx, to[0], to[1], to[2]);
+        return 0;
+    }
+
+    if (prof) {
+        ctx->move.planned = true;
+        ctx->move.prof = *prof;
+    } else {
+        ctx->move.planned = ptz_plan_profile(cfg, ctx->move.steps, &ctx->move.prof);
+    }
+
+    if (ctx->move.planned) {
+        PTZ_LOGD(cfg, "plan pan=%d tilt=%d steps t_acc=%.0fms t_total=%.0fms period=%dms",
+                 ctx->move.steps[PTZ_AXIS_PAN], ctx->move.steps[PTZ_AXIS_TILT],
+                 ctx->move.prof.t_acc * 1000.0, ctx->move.prof.total * 1000.0, ptz_plan_period_ms(cfg));
+    }
+
+    if (ptz_ctx_now(ctx, &ctx->move.t0) != 0) return -1;
+    ctx->move.next_due = ctx->move.t0; /* the first period is due at once */
+    ctx->move.active = true;
+    return 0;
+}
+
+static void plan_finish(ptz_ctx_t *ctx) {
+    ctx->move.active = false;
+    (void)ptz_set_position_steps(ctx, ctx->move.to[0], ctx->move.to[1], ctx->move.to[2]);
+    PTZ_LOGD(&ctx->cfg, "move arrived steps=%d,%d zoom=%d", ctx->move.to[0], ctx->move.to[1], ctx->move.to[2]);
+}
+
+static int plan_fail(ptz_ctx_t *ctx, ptz_axis_t axis, int step) {
+    ptz_log_line(&ctx->cfg, "absrel move failed dir=%s step=%d addr=0x%lx",
+                 ptz_dir_name(ctx->move.dir[axis]), step, ptz_axis_fd_addr(&ctx->cfg, axis));
+    (void)ptz_plan_cancel(ctx);
+    ctx->move.preempted = false;
+    ctx->move.failed = true;
+    return -1;
+}
+
+static bool plan_issued_all(const ptz_ctx_t *ctx) {
+    return ctx->move.done[0] >= ctx->move.steps[0] && ctx->move.done[1] >= ctx->move.steps[1];
+}
+
+/* Everything is issued: finish once the moving axes report idle (right away without GET_STATE). */
+static int plan_settle(ptz_ctx_t *ctx, const struct timespec *now) {
+    if (!ctx->move.settling) {
+        ctx->move.settling = true;
+        ctx->move.settle_by = ptz_timespec_add_us(*now, PLAN_SETTLE_MAX_MS * 1000L);
+        ctx->move.poll_us = 0;
+    }
+
+    bool busy = false;
+    for (int a = 0; a < 2; a++) {
+        if (ctx->move.steps[a] && ptz_motor_running(ctx, (ptz_axis_t)a) > 0) busy = true;
+    }
+
+    if (!busy || ptz_timespec_ge(now, &ctx->move.settle_by)) {
+        if (busy) ptz_log_line(&ctx->cfg, "move still running %dms after its last command, assuming arrived",
+                               PLAN_SETTLE_MAX_MS);
+        plan_finish(ctx);
+        return 0;
+    }
+
+    ctx->move.poll_us = ptz_state_poll_next(ctx->move.poll_us);
+    ctx->move.next_due = ptz_timespec_add_us(*now, ctx->move.poll_us);
+    return 0;
+}
+
+/* One period of a planned move: bring every axis to steps_a * u(end of the period). */
+static int plan_tick_profile(ptz_ctx_t *ctx, const struct timespec *now) {
+    const ptz_config_t *cfg = &ctx->cfg;
+
+    /* The last segment has had its period to run. */
+    if (plan_issued_all(ctx)) return plan_settle(ctx, now);
+
+    int period_ms = ptz_plan_period_ms(cfg);
+    double period_s = period_ms / 1000.0;
+
+    /* The period index comes from the clock: a late tick catches up instead of stretching the move. In integer
+       nanoseconds, so a tick exactly on its deadline (always, on a virtual clock) starts the next period. */
+    long long period_ns = (long long)period_ms * 1000000LL;
+    long k = (long)(elapsed_ns(&ctx->move.t0, now) / period_ns) + 1;
+#if PTZ_STATS
+    if (k > elapsed_ns(&ctx->move.t0, &ctx->move.next_due) / period_ns + 1) ptz_stats_catchup_skip(PTZ_STAT_LOOP_MOVE);
+#endif
+    double u = (k * period_s >= ctx->move.prof.total) ? 1.0 : ptz_profile_pos(&ctx->move.prof, k * period_s);
+
+    for (int a = 0; a < 2; a++) {
+        ptz_axis_t axis = (ptz_axis_t)a;
+        int delta = (int)lround(u * ctx->move.steps[a]) - ctx->move.done[a];
+        if (delta <= 0) continue;
+
+        /* Like every other SET_SPEED, only with SET_SPEED_EACH_MOVE; otherwise the driver runs each segment at
+           its own rate and the profile only shapes the segment sizes. */
+        int speed = ptz_clampi((int)ceil(delta / (period_s * PLAN_HEADROOM)), 1, ptz_axis_max_vel(cfg, axis));
+        if (cfg->set_speed_each_move && speed != ctx->move.speed[a]) {
+            if (ptz_issue_motor(ctx, axis, ptz_dir_name(ctx->move.dir[a]), speed, 1, cfg->ioctl_set_speed, false) != 0 &&
+                ctx->move.speed[a] < 0) {
+                ptz_log_line(cfg, "plan speed set failed axis=%s speed_step=%d", ptz_axis_name(axis), speed);
+            }
+            ctx->move.speed[a] = speed;
+        }
+
+        int step = ctx->move.sign[a] * delta;
+        if (ptz_issue_motor(ctx, axis, ptz_dir_name(ctx->move.dir[a]), step, 1, cfg->ioctl_move, false) != 0)
+            return plan_fail(ctx, axis, step);
+        ctx->move.done[a] += delta;
+        plan_account(ctx, axis, delta);
+    }
+
+    ctx->move.next_due = ptz_timespec_add_us(ctx->move.t0, k * period_ms * 1000L);
+    return 1;
+}
+
+/* One piece of a legacy move: ABSREL_CHUNK_STEPS on the longer axis and the same share of the other, so both
+   axes move together and arrive at once. */
+static int plan_tick_chunks(ptz_ctx_t *ctx, const struct timespec *now) {
+    const ptz_config_t *cfg = &ctx->cfg;
+    if (plan_issued_all(ctx)) return plan_settle(ctx, now);
+
+    /* The previous piece is still running: look again shortly, up to PLAN_SETTLE_MAX_MS. */
+    for (int a = 0; a < 2; a++) {
+        ptz_axis_t axis = (ptz_axis_t)a;
+        if (ctx->move.done[a] == 0 || ptz_motor_running(ctx, axis) <= 0) continue;
+        if (!ptz_timespec_ge(now, &ctx->move.settle_by)) {
+            ctx->move.poll_us = ptz_state_poll_next(ctx->move.poll_us);
+            ctx->move.next_due = ptz_timespec_add_us(*now, ctx->move.poll_us);
+            return 0;
+        }
+        ptz_log_line(cfg, "absrel piece still running %dms after it was issued, assuming done dir=%s",
+                     PLAN_SETTLE_MAX_MS, ptz_dir_name(ctx->move.dir[a]));
+        break;
+    }
+    ctx->move.poll_us = 0;
+
+    ptz_axis_t lead = (ctx->move.steps[PTZ_AXIS_PAN] >= ctx->move.steps[PTZ_AXIS_TILT]) ? PTZ_AXIS_PAN : PTZ_AXIS_TILT;
+    bool first = ctx->move.done[0] == 0 && ctx->move.done[1] == 0;
+    if (first) {
+        /* abs/rel moves have no explicit speed argument: use the configured SPEED_STEP, scaled down on the
+           shorter axis to the time the slower one needs so each piece ends on both together. */
+        double t = 0.0;
+        for (int a = 0; a < 2; a++) {
+            int full = ptz_axis_speed_step(cfg, (ptz_axis_t)a);
+            if (full > 0 && (double)ctx->move.steps[a] / full > t) t = (double)ctx->move.steps[a] / full;
+        }
+        for (int a = 0; a < 2; a++) {
+            int full = ptz_axis_speed_step(cfg, (ptz_axis_t)a);
+            int speed = full;
+            if (full > 0 && t > 0.0) {
+                speed = (int)ceil(ctx->move.steps[a] / t);
+                if (speed < 1) speed = 1;
+                if (speed > full) speed = full;
+            }
+            ctx->move.speed[a] = speed;
+            if (!ctx->move.steps[a] || !cfg->set_speed_each_move || speed <= 0) continue;
+            const char *dir = ptz_dir_name(ctx->move.dir[a]);
+            if (ptz_issue_motor(ctx, (ptz_axis_t)a, dir, speed, 1, cfg->ioctl_set_speed, true) != 0) {
+                ptz_log_line(cfg, "absrel speed set failed dir=%s speed_step=%d addr=0x%lx",
+                             dir, speed, ptz_axis_fd_addr(cfg, (ptz_axis_t)a));
+            }
+        }
+    }
+
+    int chunk = (cfg->absrel_chunk_steps > 0) ? cfg->absrel_chunk_steps : 1;
+    int lead_to = ctx->move.done[lead] + chunk;
+    if (lead_to > ctx->move.steps[lead]) lead_to = ctx->move.steps[lead];
+
+    /* With GET_STATE, first look when the piece should be done at the axis speed (steps/s); the backoff
+       above covers a slower driver. Without it, the fixed ABSREL_INTERVAL_MS. */
+    long wait_us = 0;
+    bool timed = true;
+    for (int a = 0; a < 2; a++) {
+        ptz_axis_t axis = (ptz_axis_t)a;
+        int to = (axis == lead) ? lead_to
+                                : (int)(((long long)ctx->move.steps[a] * lead_to + ctx->move.steps[lead] / 2) /
+                                        ctx->move.steps[lead]);
+        int one = to - ctx->move.done[a];
+        if (one <= 0) continue;
+
+        int step = ctx->move.sign[a] * one;
+        if (ptz_issue_motor(ctx, axis, ptz_dir_name(ctx->move.dir[a]), step, 1, cfg->ioctl_move, false) != 0)
+            return plan_fail(ctx, axis, step);
+        ctx->move.done[a] += one;
+        plan_account(ctx, axis, one);
+
+        int speed = ctx->move.speed[a];
+        if (ptz_motor_has_state(ctx, axis) && speed > 0) {
+            long us = (long)one * 1000000L / speed;
+            if (us > wait_us) wait_us = us;
+        } else {
+            timed = false;
+        }
+    }
+    ctx->move.settle_by = ptz_timespec_add_us(*now, PLAN_SETTLE_MAX_MS * 1000L);
+
+    if (!timed) wait_us = (long)((cfg->absrel_interval_ms > 0) ? cfg->absrel_interval_ms : 0) * 1000L;
+    ctx->move.next_due = ptz_timespec_add_us(*now, wait_us);
+    return 1;
+}
+
+int ptz_plan_tick(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->move.active) return 0;
+
+    struct timespec now;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+    if (!ptz_timespec_ge(&now, &ctx->move.next_due)) return 0;
+    PTZ_STAT(ptz_stats_tick(PTZ_STAT_LOOP_MOVE, &ctx->move.next_due, &now));
+
+    return ctx->move.planned ? plan_tick_profile(ctx, &now) : plan_tick_chunks(ctx, &now);
+}
+
+int ptz_move_status(const ptz_ctx_t *ctx, ptz_move_status_t *st) {
+    if (!ctx || !st) return -1;
+    memset(st, 0, sizeof(*st));
+
+    st->target_pan = ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, ctx->move.to[0]);
+    st->target_tilt = ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, ctx->move.to[1]);
+    st->target_zoom = ctx->move.to[2];
+    st->failed = ctx->move.failed;
+    st->preempted = ctx->move.preempted;
+    st->progress = 1.0;
+    if (!ctx->move.active) return 0;
+
+    st->active = true;
+    int total = ctx->move.steps[0] + ctx->move.steps[1];
+    if (total > 0) st->progress = (double)(ctx->move.done[0] + ctx->move.done[1]) / total;
+
+    if (ctx->move.planned) {
+        struct timespec now;
+        if (ptz_ctx_now(ctx, &now) == 0) {
+            double left = ctx->move.prof.total - elapsed_s(&ctx->move.t0, &now);
+            st->eta_ms = (left > 0.0) ? (long)(left * 1000.0) : 0;
+        }
+    } else {
+        int chunk = (ctx->cfg.absrel_chunk_steps > 0) ? ctx->cfg.absrel_chunk_steps : 1;
+        long pieces = 0; /* both axes share each piece; the longer one sets the count */
+        for (int a = 0; a < 2; a++) {
+            long left = (ctx->move.steps[a] - ctx->move.done[a] + chunk - 1) / chunk;
+            if (left > pieces) pieces = left;
+        }
+        st->eta_ms = pieces * ((ctx->cfg.absrel_interval_ms > 0) ? ctx->cfg.absrel_interval_ms : 0);
+    }
+    return 1;
+}
+
+int ptz_move_wait(ptz_ctx_t *ctx) {
+    if (!ctx) return -1;
+
+    unsigned id = ctx->move.id;
+    struct timespec due;
+    while (ctx->move.active && ctx->move.id == id) {
+        if (ptz_next_deadline(ctx, &due) > 0) ptz_ctx_sleep_until(ctx, &due);
+        if (ptz_tick(ctx) < 0) break;
+    }
+    if (ctx->move.id != id) return 2; /* a newer move replaced ours (and reset the flags) */
+    if (ctx->move.failed || ctx->move.active) return 1;
+    return ctx->move.preempted ? 2 : 0;
+}
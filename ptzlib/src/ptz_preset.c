@@ -0,0 +1,398 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Preset store.
+
+   STATE_DIR/ptz_presets.idx is a fixed table with one slot per id (1..PTZ_PRESET_MAX), so looking up a
+   preset is a single pread at a computed offset. Changes are appended to STATE_DIR/ptz_presets.jnl as
+   checksummed records (a torn tail record is ignored, then overwritten by the next change) and folded
+   back into the table once the journal reaches PRESET_COMPACT_AT records: rewrite to a temp file,
+   rename over the index, then drop the journal. Replaying a journal onto an index that already contains it is harmless, so a crash at any
+   point leaves a consistent store. The old text ptz_presets.db is imported once if no index exists. */
+
+#define PRESET_MAGIC       0x53525450u /* "PTRS" */
+#define PRESET_JNL_MAGIC   0x4c4e4a50u /* "PJNL" */
+#define PRESET_VERSION     1u
+#define PRESET_COMPACT_AT  32
+
+enum { PRESET_OP_SAVE = 1, PRESET_OP_DELETE = 2 };
+
+typedef struct {
+    uint8_t used;
+    uint8_t pad[3];
+    int32_t pan;
+    int32_t tilt;
+    int32_t zoom;
+    char name[PTZ_PRESET_NAME_MAX];
+} preset_slot_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t reserved;
+} preset_idx_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t op;
+    uint16_t id;
+    preset_slot_t slot;
+    uint32_t crc;
+} preset_jnl_rec_t;
+
+static uint32_t fnv1a(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void preset_paths(const ptz_config_t *cfg, char *idx, char *jnl, size_t sz) {
+    ptz_state_path(cfg, "ptz_presets.idx", idx, sz);
+    ptz_state_path(cfg, "ptz_presets.jnl", jnl, sz);
+}
+
+/* Serialize writers across processes. A separate file, since compaction unlinks the journal and renames over
+   the index. Returns the fd to pass to preset_unlock(), or -1. */
+static int preset_lock(const ptz_config_t *cfg) {
+    char path[512];
+    ptz_state_path(cfg, "ptz_presets.lock", path, sizeof(path));
+    ptz_ensure_state_dir(cfg);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    int rc;
+    while ((rc = fcntl(fd, F_SETLKW, &fl)) != 0 && errno == EINTR) {}
+    if (rc != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void preset_unlock(int fd) {
+    if (fd >= 0) close(fd); /* drops the lock */
+}
+
+static off_t slot_offset(int id) {
+    return (off_t)sizeof(preset_idx_hdr_t) + (off_t)(id - 1) * (off_t)sizeof(preset_slot_t);
+}
+
+static bool valid_id(int id) { return id >= 1 && id <= PTZ_PRESET_MAX; }
+
+static void set_name(preset_slot_t *s, const char *name) {
+    snprintf(s->name, sizeof(s->name), "%s", (name && *name) ? name : "Preset");
+    /* The listing is CSV, one preset per line. */
+    for (char *p = s->name; *p; p++) {
+        if (*p == ',' || *p == '\n' || *p == '\r') *p = '_';
+    }
+}
+
+/* Write the whole table to a temp file and rename it over the index. */
+static int write_index(const ptz_config_t *cfg, const preset_slot_t *table) {
+    char idx[512], jnl[512], tmp[520];
+    preset_paths(cfg, idx, jnl, sizeof(idx));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", idx);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    preset_idx_hdr_t hdr = { PRESET_MAGIC, PRESET_VERSION, PTZ_PRESET_MAX, 0 };
+    size_t tbl_sz = sizeof(preset_slot_t) * PTZ_PRESET_MAX;
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              write(fd, table, tbl_sz) == (ssize_t)tbl_sz &&
+              fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp, idx) != 0) {
+        (void)unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static void import_legacy_db(const ptz_config_t *cfg, preset_slot_t *table) {
+    char path[512];
+    ptz_state_path(cfg, "ptz_presets.db", path, sizeof(path));
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int id, px, py, pz;
+        char name[128];
+        if (sscanf(line, "%d,%127[^,],%d,%d,%d", &id, name, &px, &py, &pz) != 5 || !valid_id(id)) continue;
+
+        preset_slot_t *s = &table[id - 1];
+        s->used = 1;
+        s->pan = px;
+        s->tilt = py;
+        s->zoom = pz;
+        set_name(s, name);
+    }
+    fclose(f);
+}
+
+static int open_index(const ptz_config_t *cfg) {
+    char idx[512], jnl[512];
+    preset_paths(cfg, idx, jnl, sizeof(idx));
+
+    int fd = open(idx, O_RDONLY);
+    if (fd < 0 && errno == ENOENT) {
+        /* First use: create the index, seeded from the legacy text store if present. */
+        preset_slot_t table[PTZ_PRESET_MAX];
+        memset(table, 0, sizeof(table));
+        import_legacy_db(cfg, table);
+        ptz_ensure_state_dir(cfg);
+        if (write_index(cfg, table) != 0) return -1;
+        fd = open(idx, O_RDONLY);
+    }
+    if (fd < 0) return -1;
+
+    preset_idx_hdr_t hdr;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != PRESET_MAGIC || hdr.version != PRESET_VERSION || hdr.slots != PTZ_PRESET_MAX) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool jnl_rec_valid(const preset_jnl_rec_t *r) {
+    return r->magic == PRESET_JNL_MAGIC && r->crc == fnv1a(r, offsetof(preset_jnl_rec_t, crc));
+}
+
+/* Replay journal records onto `table` (all ids), or onto table[0] for a single id. */
+static void apply_journal(const ptz_config_t *cfg, int only_id, preset_slot_t *table) {
+    char idx[512], jnl[512];
+    preset_paths(cfg, idx, jnl, sizeof(idx));
+
+    int fd = open(jnl, O_RDONLY);
+    if (fd < 0) return;
+
+    preset_jnl_rec_t r;
+    while (read(fd, &r, sizeof(r)) == (ssize_t)sizeof(r)) {
+        if (!jnl_rec_valid(&r)) break;
+        if (!valid_id(r.id) || (only_id && r.id != only_id)) continue;
+
+        preset_slot_t *s = only_id ? &table[0] : &table[r.id - 1];
+        if (r.op == PRESET_OP_SAVE) *s = r.slot;
+        else if (r.op == PRESET_OP_DELETE) memset(s, 0, sizeof(*s));
+    }
+    close(fd);
+}
+
+/* Full table: index plus pending journal records. */
+static int load_table(const ptz_config_t *cfg, preset_slot_t *table) {
+    int fd = open_index(cfg);
+    if (fd < 0) return -1;
+
+    size_t tbl_sz = sizeof(preset_slot_t) * PTZ_PRESET_MAX;
+    ssize_t n = pread(fd, table, tbl_sz, slot_offset(1));
+    close(fd);
+    if (n != (ssize_t)tbl_sz) return -1;
+
+    apply_journal(cfg, 0, table);
+    return 0;
+}
+
+static int lookup(const ptz_config_t *cfg, int id, preset_slot_t *out) {
+    int fd = open_index(cfg);
+    if (fd < 0) return -1;
+
+    ssize_t n = pread(fd, out, sizeof(*out), slot_offset(id));
+    close(fd);
+    if (n != (ssize_t)sizeof(*out)) return -1;
+
+    apply_journal(cfg, id, out);
+    return out->used ? 0 : -1;
+}
+
+static int compact(const ptz_config_t *cfg) {
+    preset_slot_t table[PTZ_PRESET_MAX];
+    if (load_table(cfg, table) != 0) return -1;
+    if (write_index(cfg, table) != 0) return -1;
+
+    char idx[512], jnl[512];
+    preset_paths(cfg, idx, jnl, sizeof(idx));
+    (void)unlink(jnl);
+    return 0;
+}
+
+static int append_journal(const ptz_config_t *cfg, int op, int id, const preset_slot_t *slot) {
+    /* Make sure an index exists (and the legacy store is imported) before journaling on top of it. */
+    int ifd = open_index(cfg);
+    if (ifd < 0) return -1;
+    close(ifd);
+
+    char idx[512], jnl[512];
+    preset_paths(cfg, idx, jnl, sizeof(idx));
+
+    preset_jnl_rec_t r;
+    memset(&r, 0, sizeof(r));
+    r.magic = PRESET_JNL_MAGIC;
+    r.op = (uint16_t)op;
+    r.id = (uint16_t)id;
+    if (slot) r.slot = *slot;
+    r.crc = fnv1a(&r, offsetof(preset_jnl_rec_t, crc));
+
+    int fd = open(jnl, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+
+    /* Replay stops at the first bad record, so anything appended after a torn one would be lost: write over
+       it instead, at the end of the last valid record. */
+    off_t end = 0;
+    preset_jnl_rec_t old;
+    while (pread(fd, &old, sizeof(old), end) == (ssize_t)sizeof(old) && jnl_rec_valid(&old))
+        end += (off_t)sizeof(old);
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (st.st_size == end || ftruncate(fd, end) == 0) &&
+              pwrite(fd, &r, sizeof(r), end) == (ssize_t)sizeof(r) && fdatasync(fd) == 0;
+    if (ok && st.st_size > end) ptz_log_line(cfg, "preset journal: dropped %ld torn bytes", (long)(st.st_size - end));
+
+    bool full = ok && end + (off_t)sizeof(r) >= (off_t)(sizeof(r) * PRESET_COMPACT_AT);
+    close(fd);
+
+    if (!ok) return -1;
+    if (full && compact(cfg) != 0) ptz_log_line(cfg, "preset journal compaction failed");
+    return 0;
+}
+
+int ptz_preset_save(ptz_ctx_t *ctx, int id, const char *name) {
+    if (!ctx) return -1;
+
+    int lk = preset_lock(&ctx->cfg);
+    if (lk < 0) return -1;
+
+    if (id <= 0) {
+        /* Next id after the highest one in use, like the old shell helper. */
+        preset_slot_t table[PTZ_PRESET_MAX];
+        if (load_table(&ctx->cfg, table) != 0) {
+            preset_unlock(lk);
+            return -1;
+        }
+        id = 1;
+        for (int i = PTZ_PRESET_MAX; i >= 1; i--) {
+            if (table[i - 1].used) {
+                id = i + 1;
+                break;
+            }
+        }
+        if (!valid_id(id)) {
+            for (id = 1; id <= PTZ_PRESET_MAX && table[id - 1].used; id++) {}
+        }
+    }
+    if (!valid_id(id)) {
+        preset_unlock(lk);
+        return -1;
+    }
+
+    preset_slot_t s;
+    memset(&s, 0, sizeof(s));
+    int x, y, z;
+    (void)ptz_get_position(ctx, &x, &y, &z);
+    s.used = 1;
+    s.pan = x;
+    s.tilt = y;
+    s.zoom = z;
+    set_name(&s, name);
+
+    int rc = append_journal(&ctx->cfg, PRESET_OP_SAVE, id, &s);
+    preset_unlock(lk);
+    if (rc != 0) return -1;
+    ptz_log_line(&ctx->cfg, "preset save id=%d name=%s pos=%d,%d,%d", id, s.name, x, y, z);
+    return id;
+}
+
+int ptz_preset_delete(ptz_ctx_t *ctx, int id) {
+    if (!ctx || !valid_id(id)) return -1;
+
+    int lk = preset_lock(&ctx->cfg);
+    if (lk < 0) return -1;
+    int rc = append_journal(&ctx->cfg, PRESET_OP_DELETE, id, NULL);
+    preset_unlock(lk);
+    if (rc != 0) return -1;
+    ptz_log_line(&ctx->cfg, "preset delete id=%d", id);
+    return 0;
+}
+
+int ptz_preset_list(ptz_ctx_t *ctx, ptz_preset_t *out, int max) {
+    if (!ctx || (!out && max > 0)) return -1;
+
+    preset_slot_t table[PTZ_PRESET_MAX];
+    if (load_table(&ctx->cfg, table) != 0) return -1;
+
+    int n = 0;
+    for (int i = 0; i < PTZ_PRESET_MAX; i++) {
+        if (!table[i].used) continue;
+        if (n < max) {
+            out[n].id = i + 1;
+            snprintf(out[n].name, sizeof(out[n].name), "%s", table[i].name);
+            out[n].pan_deg = table[i].pan;
+            out[n].tilt_deg = table[i].tilt;
+            out[n].zoom = table[i].zoom;
+        }
+        n++;
+    }
+    return n;
+}
+
+int ptz_format_presets(ptz_ctx_t *ctx, char *out, size_t out_sz) {
+    if (!out || !out_sz) return -1;
+    ptz_preset_t list[PTZ_PRESET_MAX];
+    int n = ptz_preset_list(ctx, list, PTZ_PRESET_MAX);
+    if (n < 0) return -1;
+
+    size_t used = 0;
+    out[0] = '\0';
+    for (int i = 0; i < n && i < PTZ_PRESET_MAX; i++) {
+        int w = snprintf(out + used, out_sz - used, "%d,%s,%d,%d,%d\n", list[i].id, list[i].name,
+                         list[i].pan_deg, list[i].tilt_deg, list[i].zoom);
+        if (w < 0 || (size_t)w >= out_sz - used) return -1; /* a cut-off list would read as fewer presets */
+        used += (size_t)w;
+    }
+    return 0;
+}
+
+int ptz_preset_goto_start(ptz_ctx_t *ctx, int id) {
+    if (!ctx) return -1;
+
+    preset_slot_t s;
+    if (!valid_id(id) || lookup(&ctx->cfg, id, &s) != 0) {
+        ptz_log_line(&ctx->cfg, "preset %d not found", id);
+        return 1;
+    }
+
+    ptz_log_line(&ctx->cfg, "move preset=%d -> pos=%d,%d,%d", id, s.pan, s.tilt, s.zoom);
+    return ptz_move_abs_deg_start(ctx, s.pan, s.tilt, s.zoom);
+}
+
+int ptz_preset_goto(ptz_ctx_t *ctx, int id) {
+    int rc = ptz_preset_goto_start(ctx, id);
+    if (rc != 0) return rc;
+    return ptz_move_wait(ctx);
+}
+
+int ptz_move_preset(ptz_ctx_t *ctx, const char *preset_id) {
+    if (!ctx || !preset_id || !*preset_id) return -1;
+    return ptz_preset_goto(ctx, atoi(preset_id));
+}
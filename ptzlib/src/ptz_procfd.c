@@ -0,0 +1,181 @@
+/* syscall() for pidfd_open/pidfd_getfd is not exposed under plain POSIX. */
+#define _GNU_SOURCE
+#include "ptz_internal.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Legacy backend: borrow the motor FD that anyka_ipc already holds.
+
+   Resolving it means a /proc readdir to find the PID, a /proc/PID/mem read of the FD number and an
+   open of /proc/PID/fd/N. All of that is done once per anyka_ipc lifetime; the identity (PID + start
+   time, plus a pidfd when the kernel has one) is cached in ctx->proc and checked cheaply before each use. */
+
+static int sys_pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int sys_pidfd_getfd(int pidfd, int targetfd) {
+#ifdef SYS_pidfd_getfd
+    return (int)syscall(SYS_pidfd_getfd, pidfd, targetfd, 0);
+#else
+    (void)pidfd;
+    (void)targetfd;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Field 22 of /proc/PID/stat (starttime, in clock ticks since boot). 0 if unavailable. */
+static unsigned long long proc_start_time(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    char buf[512];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+
+    /* comm (field 2) may contain spaces and parentheses; fields after the last ')' are plain. */
+    char *p = strrchr(buf, ')');
+    if (!p) return 0;
+    p++;
+
+    for (int field = 3; field < 22; field++) {
+        while (*p == ' ') p++;
+        while (*p && *p != ' ') p++;
+        if (!*p) return 0;
+    }
+    return strtoull(p, NULL, 10);
+}
+
+static pid_t find_pid_by_name(const char *name) {
+    DIR *d = opendir("/proc");
+    if (!d) return -1;
+
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (!isdigit((unsigned char)de->d_name[0])) continue;
+
+        pid_t pid = (pid_t)atoi(de->d_name);
+
+        char comm_path[256];
+        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", (int)pid);
+
+        FILE *f = fopen(comm_path, "r");
+        if (!f) continue;
+
+        char comm[128];
+        if (!fgets(comm, sizeof(comm), f)) {
+            fclose(f);
+            continue;
+        }
+        fclose(f);
+
+        comm[strcspn(comm, "\r\n")] = '\0';
+        if (strcmp(comm, name) == 0) {
+            closedir(d);
+            return pid;
+        }
+    }
+
+    closedir(d);
+    return -1;
+}
+
+static int read_motor_fd(pid_t pid, unsigned long addr) {
+    char mem_path[256];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+
+    int memfd = open(mem_path, O_RDONLY);
+    if (memfd < 0) return -1;
+
+    uint32_t mfd = 0;
+    ssize_t n = pread(memfd, &mfd, sizeof(mfd), (off_t)addr);
+    close(memfd);
+
+    if (n != (ssize_t)sizeof(mfd)) return -1;
+    return (int)mfd;
+}
+
+void ptz_procfd_reset(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+    if (ctx->proc.pidfd >= 0) close(ctx->proc.pidfd);
+    ctx->proc.pid = -1;
+    ctx->proc.start_time = 0;
+    ctx->proc.pidfd = -1;
+}
+
+bool ptz_procfd_stale(const ptz_ctx_t *ctx) {
+    if (!ctx || ctx->proc.pid <= 0) return true;
+
+    /* A pidfd becomes readable once the process exits: one poll() instead of a /proc read. */
+    if (ctx->proc.pidfd >= 0) {
+        struct pollfd pfd = { .fd = ctx->proc.pidfd, .events = POLLIN, .revents = 0 };
+        return poll(&pfd, 1, 0) != 0;
+    }
+
+    return proc_start_time((pid_t)ctx->proc.pid) != ctx->proc.start_time;
+}
+
+static int resolve_pid(ptz_ctx_t *ctx) {
+    if (ctx->proc.pid > 0 && !ptz_procfd_stale(ctx)) return 0;
+
+    ptz_procfd_reset(ctx);
+
+    const ptz_config_t *cfg = &ctx->cfg;
+    pid_t pid = (cfg->anyka_pid > 1) ? (pid_t)cfg->anyka_pid : find_pid_by_name(cfg->anyka_proc);
+    if (pid < 0) return -1;
+
+    unsigned long long st = proc_start_time(pid);
+    if (!st) return -1;
+
+    ctx->proc.pid = (int)pid;
+    ctx->proc.start_time = st;
+    ctx->proc.pidfd = sys_pidfd_open(pid);
+    if (ctx->proc.pidfd >= 0) (void)fcntl(ctx->proc.pidfd, F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+int ptz_procfd_open(ptz_ctx_t *ctx, unsigned long fd_addr, char *dbg, size_t dbg_sz) {
+    if (!ctx || fd_addr == 0) return -1;
+    if (resolve_pid(ctx) != 0) return -1;
+
+    pid_t pid = (pid_t)ctx->proc.pid;
+    int mfd = read_motor_fd(pid, fd_addr);
+    if (mfd <= 0) return -1;
+
+    /* Prefer duplicating the very same open file description; fall back to reopening via /proc. */
+    int devfd = (ctx->proc.pidfd >= 0) ? sys_pidfd_getfd(ctx->proc.pidfd, mfd) : -1;
+    const char *how = "pidfd";
+
+    char fd_path[64];
+    snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd/%d", (int)pid, mfd);
+    if (devfd < 0) {
+        devfd = open(fd_path, O_RDWR);
+        how = "proc";
+    }
+    if (devfd < 0) return -1;
+
+    if (dbg && dbg_sz) snprintf(dbg, dbg_sz, "%s:%s (pid=%d mfd=%d)", how, fd_path, (int)pid, mfd);
+    return devfd;
+}
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* Config hot reload.
+
+   The watch is on the config file's directory rather than the file itself: editors and `sed -i` replace the
+   file by rename, which a watch on the old inode would never report. Nothing happens behind the caller's
+   back; ptz_config_reload() is called between ticks (ptzd does it when the watch fd polls readable), so the
+   swap is atomic with respect to everything ptz_tick() does. */
+
+#define RELOAD_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB)
+
+#define SAME(a, b, field) (memcmp(&(a)->field, &(b)->field, sizeof((a)->field)) == 0)
+
+static bool kin_changed(const ptz_config_t *a, const ptz_config_t *b) {
+    return !SAME(a, b, pan_max_deg) || !SAME(a, b, pan_total_steps) || !SAME(a, b, pan_invert) ||
+           !SAME(a, b, tilt_max_deg) || !SAME(a, b, tilt_total_steps) || !SAME(a, b, tilt_invert);
+}
+
+/* Keys baked into an armed continuous axis's step (besides the calibration). */
+static bool steps_changed(const ptz_config_t *a, const ptz_config_t *b) {
+    return !SAME(a, b, step_mult) || !SAME(a, b, step_repeat) || !SAME(a, b, pan_step_mult) ||
+           !SAME(a, b, pan_step_repeat) || !SAME(a, b, tilt_step_mult) || !SAME(a, b, tilt_step_repeat) ||
+           !SAME(a, b, tilt_step_abs_max) || !SAME(a, b, tilt_up_step_mult) || !SAME(a, b, tilt_up_step_repeat) ||
+           !SAME(a, b, tilt_up_step_abs_max) || !SAME(a, b, tilt_down_step_mult) ||
+           !SAME(a, b, tilt_down_step_repeat) || !SAME(a, b, tilt_down_step_abs_max) ||
+           !SAME(a, b, continuous_step_div) || !SAME(a, b, continuous_rep);
+}
+
+/* Keys the tour's legs were planned with (besides the calibration). */
+static bool plan_changed(const ptz_config_t *a, const ptz_config_t *b) {
+    return !SAME(a, b, pan_max_vel) || !SAME(a, b, pan_accel) || !SAME(a, b, tilt_max_vel) ||
+           !SAME(a, b, tilt_accel) || !SAME(a, b, absrel_interval_ms) || !SAME(a, b, absrel_chunk_steps) ||
+           !SAME(a, b, pan_speed_step) || !SAME(a, b, tilt_speed_step);
+}
+
+static bool motors_changed(const ptz_config_t *a, const ptz_config_t *b) {
+    return !SAME(a, b, motor_backend) || !SAME(a, b, pan_dev) || !SAME(a, b, tilt_dev) ||
+           !SAME(a, b, anyka_proc) || !SAME(a, b, anyka_pid) ||
+           !SAME(a, b, pan_fd_addr) || !SAME(a, b, tilt_fd_addr);
+}
+
+int ptz_ctx_reconfigure(ptz_ctx_t *ctx, const ptz_config_t *cfg) {
+    if (!ctx || !cfg) return -1;
+
+    char why[96];
+    if (ptz_config_validate(cfg, why, sizeof(why)) != 0) {
+        ptz_log_line(&ctx->cfg, "config rejected: %s", why);
+        return -1;
+    }
+
+    ptz_config_t next = *cfg;
+    if (!SAME(&ctx->cfg, &next, ptzd_socket)) {
+        ptz_log_line(&ctx->cfg, "config: PTZD_SOCKET change needs a restart, keeping %s", ctx->cfg.ptzd_socket);
+        memcpy(next.ptzd_socket, ctx->cfg.ptzd_socket, sizeof(next.ptzd_socket));
+    }
+    /* Producers have the served ring mapped and its doorbell open. */
+    if (ctx->cmdq.ring && (!SAME(&ctx->cfg, &next, cmdq_file) || !SAME(&ctx->cfg, &next, cmdq_slots))) {
+        ptz_log_line(&ctx->cfg, "config: CMDQ_FILE/CMDQ_SLOTS change needs a restart, keeping %s",
+                     ctx->cfg.cmdq_file);
+        memcpy(next.cmdq_file, ctx->cfg.cmdq_file, sizeof(next.cmdq_file));
+        next.cmdq_slots = ctx->cfg.cmdq_slots;
+    }
+
+    char keys[256];
+    int n = ptz_config_diff(&ctx->cfg, &next, keys, sizeof(keys));
+    if (!n) return 0;
+
+    ptz_config_t prev = ctx->cfg;
+    bool kin = kin_changed(&prev, &next);
+    bool motors = motors_changed(&prev, &next);
+    bool state = !SAME(&prev, &next, state_dir);
+
+    /* A move in flight was planned in the old calibration's steps; stop it rather than finish it wrongly. */
+    if (kin && ctx->move.active) {
+        ptz_log_line(&ctx->cfg, "config: calibration changed, stopping the abs/rel move");
+        ptz_plan_preempt(ctx);
+    }
+    /* An armed continuous axis keeps the step it was armed with, in the old tuning and polarity, and would account
+       it through the new inversion. Stop it; the next command arms with the new config. */
+    if (kin || steps_changed(&prev, &next)) {
+        bool stopped = false;
+        for (int a = 0; a < 2; a++) {
+            if (!ctx->cont[a].active) continue;
+            ptz_log_line(&ctx->cfg, "config: step tuning changed, stopping the continuous %s move",
+                         ptz_axis_name((ptz_axis_t)a));
+            ptz_continuous_disarm(ctx, (ptz_axis_t)a);
+            (void)ptz_issue_motor(ctx, (ptz_axis_t)a, "", 0, 1, ctx->cfg.ioctl_stop, true);
+            stopped = true;
+        }
+        if (stopped) (void)ptz_export_position(ctx);
+    }
+
+    int pos[3] = { 0, 0, 0 };
+    bool have_pos = state && ptz_get_position_steps(ctx, &pos[0], &pos[1], &pos[2]) == 0;
+
+    ctx->cfg = next;
+
+    if (state) {
+        /* The head has not moved: carry the position over into the new directory's state. */
+        ptz_state_close(ctx);
+        ptz_ensure_state_dir(&ctx->cfg);
+        if (ptz_state_open(ctx) != 0)
+            ptz_log_line(&ctx->cfg, "state mmap unavailable in %s, using text position file", ctx->cfg.state_dir);
+        if (have_pos) (void)ptz_set_position_steps(ctx, pos[0], pos[1], pos[2]);
+        if (ctx->state) ctx->motion_gen = atomic_load_explicit(&ctx->state->motion_gen, memory_order_acquire);
+    }
+    if (kin) ptz_kin_init(ctx);
+    ptz_dir_init(ctx); /* STEP_* and *_INVERT for the next command; cheap enough to redo on every change */
+    if (kin || plan_changed(&prev, &next)) ptz_tour_replan(ctx);
+
+    if (!SAME(&prev, &next, trace_file) || !SAME(&prev, &next, trace_records)) {
+        ptz_trace_close(ctx);
+        if (ptz_trace_open(ctx) != 0) ptz_log_line(&ctx->cfg, "trace %s unavailable, not tracing", ctx->cfg.trace_file);
+    }
+
+    if (motors) {
+        /* Closed here, reopened by the next command through the new backend/device. */
+        ptz_motor_close(ctx);
+        for (int a = 0; a < 2; a++) ctx->cont[a].fd_addr = ptz_axis_fd_addr(&ctx->cfg, (ptz_axis_t)a);
+        if (ctx->cfg.motor_backend == PTZ_MOTOR_BACKEND_SIM && prev.motor_backend != PTZ_MOTOR_BACKEND_SIM)
+            ptz_sim_init(ctx);
+    }
+    if (motors || !SAME(&prev, &next, ioctl_get_state)) {
+        for (int a = 0; a < 2; a++) ctx->motor[a].no_state = false;
+    }
+
+    ptz_log_line(&ctx->cfg, "config reloaded: %s", keys);
+    return 0;
+}
+
+int ptz_config_watch(ptz_ctx_t *ctx, const char *path) {
+    if (!ctx || !path || !*path) return -1;
+
+    char dir[256];
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    if (!*name || strlen(path) >= sizeof(ctx->reload.path) || strlen(name) >= sizeof(ctx->reload.name)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (!slash) snprintf(dir, sizeof(dir), ".");
+    else if (slash == path) snprintf(dir, sizeof(dir), "/");
+    else snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    if (inotify_add_watch(fd, dir, RELOAD_EVENTS) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+
+    if (ctx->reload.fd >= 0) close(ctx->reload.fd);
+    ctx->reload.fd = fd;
+    snprintf(ctx->reload.path, sizeof(ctx->reload.path), "%s", path);
+    snprintf(ctx->reload.name, sizeof(ctx->reload.name), "%s", name);
+    return fd;
+}
+
+/* Drain pending events; true if any of them concerns the config file. */
+static bool drain_events(ptz_ctx_t *ctx) {
+    bool hit = false;
+    _Alignas(struct inotify_event) char buf[4096];
+
+    for (;;) {
+        ssize_t n = read(ctx->reload.fd, buf, sizeof(buf));
+        if (n <= 0) break;
+
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) hit = true;
+            else if (ev->len && strcmp(ev->name, ctx->reload.name) == 0) hit = true;
+            if (ev->mask & IN_IGNORED)
+                ptz_log_line(&ctx->cfg, "config watch on %s lost (directory removed)", ctx->reload.path);
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    return hit;
+}
+
+int ptz_config_reload(ptz_ctx_t *ctx) {
+    if (!ctx || ctx->reload.fd < 0) return 0;
+    if (!drain_events(ctx)) return 0;
+
+    ptz_config_t next;
+    ptz_config_init_defaults(&next);
+    /* Mid-replace the file may briefly be missing; the rename that completes it raises another event. */
+    if (ptz_config_load_file(&next, ctx->reload.path) != 0) return 0;
+    /* Restart-only, and ptzd may have overridden it with -S. */
+    memcpy(next.ptzd_socket, ctx->cfg.ptzd_socket, sizeof(next.ptzd_socket));
+    if (ptz_config_diff(&ctx->cfg, &next, NULL, 0) == 0) return 0;
+
+    return (ptz_ctx_reconfigure(ctx, &next) == 0) ? 1 : -1;
+}
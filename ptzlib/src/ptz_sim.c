@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* Simulated ak_motor (MOTOR_BACKEND=3).
+
+   Lets the library run, and be timed, on a machine without /dev/motorX. Each axis is a stepper
+   that moves at a constant rate towards a target step, with end stops at 0 and *_TOTAL_STEPS:
+     MOVE        head for `step` steps from where it is now, replacing a target still in flight (so STEP_REPEAT
+                 keeps it going rather than adding distance), clamped to the end stops
+     STOP        hold at the current position
+     SET_SPEED   steps per second from now on (SIM_STEP_RATE until the first SET_SPEED)
+     GET_STATE   fill a struct ptz_motor_msg
+     TURN_MIDDLE travel to total_steps / 2
+   Commands are matched against the IOCTL_* map, so a miscalibrated map fails here like it would on
+   the device. Every call also costs SIM_IOCTL_LATENCY_US to model the syscall + driver overhead.
+   Position is derived from the monotonic clock on demand; nothing runs in the background. */
+
+static int axis_limit(const ptz_config_t *cfg, ptz_axis_t axis) {
+    int n = (axis == PTZ_AXIS_PAN) ? cfg->pan_total_steps : cfg->tilt_total_steps;
+    return (n > 0) ? n : 1;
+}
+
+static int axis_rate(const ptz_ctx_t *ctx, ptz_axis_t axis) {
+    int r = ctx->sim[axis].speed_step;
+    if (r <= 0) r = ctx->cfg.sim_step_rate;
+    return (r > 0) ? r : 1;
+}
+
+/* Steps travelled since t0 (unclamped, fractional). */
+static double sim_moved(const ptz_ctx_t *ctx, ptz_axis_t axis, const struct timespec *now) {
+    double dt = (double)(now->tv_sec - ctx->sim[axis].t0.tv_sec) +
+                (double)(now->tv_nsec - ctx->sim[axis].t0.tv_nsec) / 1e9;
+    return (dt > 0) ? dt * axis_rate(ctx, axis) : 0.0;
+}
+
+/* True step position at `now`. */
+static int sim_pos_at(const ptz_ctx_t *ctx, ptz_axis_t axis, const struct timespec *now) {
+    int from = ctx->sim[axis].from;
+    int dist = ctx->sim[axis].target - from;
+    if (!dist) return from;
+
+    double moved = sim_moved(ctx, axis, now);
+    int adist = (dist < 0) ? -dist : dist;
+    if (moved >= adist) return ctx->sim[axis].target;
+    return from + ((dist < 0) ? -(int)moved : (int)moved);
+}
+
+/* Restart the motion segment at `now` (after a speed or target change). The partial step in
+   progress is kept by back-dating t0, so frequent commands don't lose distance. */
+static void sim_rebase(ptz_ctx_t *ctx, ptz_axis_t axis, const struct timespec *now) {
+    int pos = sim_pos_at(ctx, axis, now);
+    double frac = 0.0;
+    if (pos != ctx->sim[axis].target) {
+        double moved = sim_moved(ctx, axis, now);
+        frac = moved - (double)(int)moved;
+    }
+
+    ctx->sim[axis].from = pos;
+    ctx->sim[axis].t0 = *now;
+    if (frac > 0.0) {
+        long back_ns = (long)(frac / axis_rate(ctx, axis) * 1e9);
+        ctx->sim[axis].t0.tv_sec -= back_ns / 1000000000L;
+        ctx->sim[axis].t0.tv_nsec -= back_ns % 1000000000L;
+        if (ctx->sim[axis].t0.tv_nsec < 0) {
+            ctx->sim[axis].t0.tv_sec -= 1;
+            ctx->sim[axis].t0.tv_nsec += 1000000000L;
+        }
+    }
+}
+
+void ptz_sim_init(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+
+    /* Start where the saved position says the head is, so a short-lived ptzctl continues from there.
+       The simulated driver counts in its own direction, so an inverted axis is mirrored. */
+    int pos[2] = { ctx->kin[PTZ_AXIS_PAN].total_steps / 2, ctx->kin[PTZ_AXIS_TILT].total_steps / 2 }, z = 0;
+    (void)ptz_get_position_steps(ctx, &pos[0], &pos[1], &z);
+
+    struct timespec now = { 0, 0 };
+    (void)ptz_ctx_now(ctx, &now);
+
+    for (int a = 0; a < 2; a++) {
+        int limit = axis_limit(&ctx->cfg, (ptz_axis_t)a);
+        int p = ptz_clampi(pos[a], 0, limit);
+        if (ctx->kin[a].invert) p = limit - p;
+
+        ctx->sim[a].from = ctx->sim[a].target = p;
+        ctx->sim[a].speed_step = 0;
+        ctx->sim[a].t0 = now;
+    }
+}
+
+int ptz_sim_ioctl(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, void *arg) {
+    if (!ctx || !arg) {
+        errno = EFAULT;
+        return -1;
+    }
+    const ptz_config_t *cfg = &ctx->cfg;
+
+    if (cfg->sim_ioctl_latency_us > 0) ptz_ctx_sleep_us(ctx, cfg->sim_ioctl_latency_us);
+
+    struct timespec now;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+
+    int limit = axis_limit(cfg, axis);
+
+    if (cmd == cfg->ioctl_move) {
+        int32_t step;
+        memcpy(&step, arg, sizeof(step));
+        sim_rebase(ctx, axis, &now);
+        ctx->sim[axis].target = ptz_clampi(ctx->sim[axis].from + step, 0, limit);
+        return 0;
+    }
+
+    if (cmd == cfg->ioctl_stop) {
+        sim_rebase(ctx, axis, &now);
+        ctx->sim[axis].target = ctx->sim[axis].from;
+        return 0;
+    }
+
+    if (cmd == cfg->ioctl_set_speed) {
+        int32_t speed;
+        memcpy(&speed, arg, sizeof(speed));
+        if (speed <= 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        sim_rebase(ctx, axis, &now);
+        ctx->sim[axis].speed_step = speed;
+        return 0;
+    }
+
+    if (cmd == cfg->ioctl_turn_middle) {
+        sim_rebase(ctx, axis, &now);
+        ctx->sim[axis].target = limit / 2;
+        return 0;
+    }
+
+    if (cmd == cfg->ioctl_get_state) {
+        struct ptz_motor_msg msg;
+        memset(&msg, 0, sizeof(msg));
+
+        int pos = sim_pos_at(ctx, axis, &now);
+        msg.pos = pos;
+        msg.speed_step = axis_rate(ctx, axis);
+        msg.steps_one_circle = limit;
+        msg.total_steps = limit;
+        msg.boundary_steps = 0;
+        if (pos != ctx->sim[axis].target) msg.status |= PTZ_MOTOR_RUNNING;
+        if (pos <= 0) msg.status |= PTZ_MOTOR_AT_MIN;
+        if (pos >= limit) msg.status |= PTZ_MOTOR_AT_MAX;
+
+        memcpy(arg, &msg, sizeof(msg));
+        return 0;
+    }
+
+    errno = ENOTTY;
+    return -1;
+}
@@ -1,74 +1,379 @@
 #define _POSIX_C_SOURCE 200809L
 #include "ptz_internal.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
-int ptz_get_position(const ptz_ctx_t *ctx, int *pan_deg, int *tilt_deg, int *zoom) {
-    if (!ctx || !pan_deg || !tilt_deg || !zoom) return -1;
+/* Binary position state.
 
-    int x = 180, y = 98, z = 0;
+   STATE_DIR/ptz_state.bin holds a fixed-layout record that every context mmaps (MAP_SHARED), so reads
+   and writes are plain memory accesses instead of fopen/fscanf/fprintf on the SD card. Updates are
+   published with a seqlock: the writer makes seq odd, stores the payload, then makes it even again;
+   readers retry until they see the same even seq on both sides of their copy, so a reader in another
+   process never sees a torn pan/tilt/zoom triple. Writers claim the odd state with a CAS, which also
+   serializes concurrent writers, and record their pid; a seq left odd is taken over only once that
+   process is gone (or the pid is from an earlier boot, since the file lives on the SD card). A checksum over the payload catches a torn page after power loss;
+   the text ptz_position file is kept as an optional export (POSITION_TEXT_EXPORT) for shell scripts.
 
-    char path[512];
-    ptz_state_path(&ctx->cfg, "ptz_position", path, sizeof(path));
+   Pan and tilt are stored in motor steps (0..*_TOTAL_STEPS), so moves add exactly the steps they issued and
+   nothing is lost to rounding. Degrees (the public API, presets, the text export) are derived with the
+   16.16 fixed-point factors in ctx->kin, computed once per context.
 
-    FILE *f = fopen(path, "r");
-    if (f) {
-        if (fscanf(f, "%d,%d,%d", &x, &y, &z) != 3) {
-            x = 180; y = 98; z = 0;
+   The same block arbitrates motion between processes: each motion command takes the write section, bumps
+   motion_gen and records its pid. A ptzctl still ticking a continuous or abs move sees the generation move
+   on and drops its move on its next tick, so the last command wins and only one process drives the motors. */
+
+#define STATE_MAGIC      0x53545a50u /* "PTZS" */
+#define STATE_VERSION    4u /* 2: pan/tilt in steps, 3: motion owner, 4: writer pid */
+#define STATE_SPIN_MAX   100000
+#define STATE_STEAL_MS   50   /* how long seq must stay odd before the holder's pid is checked */
+#define STATE_ANON_MS    1000 /* the same for a holder killed before it could record its pid */
+
+#define DEFAULT_PAN_DEG  180
+#define DEFAULT_TILT_DEG 98
+
+static uint32_t state_checksum(const struct ptz_state_shm *st) {
+    /* FNV-1a over the payload fields. */
+    const int32_t v[3] = { st->pan, st->tilt, st->zoom };
+    const uint8_t *p = (const uint8_t *)v;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(v); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* A token for the current boot, so a pid left in the file before a reboot is not mistaken for a live
+   process. 0 when unknown, which leaves the pid check alone. */
+static uint32_t state_boot_id(void) {
+    static uint32_t boot;
+    static bool known;
+    if (known) return boot;
+    known = true;
+
+    char buf[64] = {0};
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return boot;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    uint32_t h = 2166136261u;
+    for (ssize_t i = 0; i < n; i++) {
+        h ^= (uint8_t)buf[i];
+        h *= 16777619u;
+    }
+    boot = (n > 0) ? (h | 1u) : 0u;
+    return boot;
+}
+
+static bool state_writer_gone(const struct ptz_state_shm *st) {
+    struct ptz_state_shm *w = (struct ptz_state_shm *)st;
+    int32_t pid = atomic_load_explicit(&w->writer_pid, memory_order_relaxed);
+    uint32_t boot = atomic_load_explicit(&w->writer_boot, memory_order_relaxed);
+    if (pid <= 0) return true;
+    if (boot && state_boot_id() && boot != state_boot_id()) return true;
+    return kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+}
+
+static void state_write_begin(struct ptz_state_shm *st) {
+    uint32_t seen = atomic_load_explicit(&st->seq, memory_order_relaxed);
+    struct timespec since;
+    (void)ptz_now_monotonic(&since);
+
+    for (;;) {
+        uint32_t s = atomic_load_explicit(&st->seq, memory_order_relaxed);
+        if (!(s & 1u)) {
+            if (atomic_compare_exchange_weak_explicit(&st->seq, &s, s + 1u,
+                                                      memory_order_acquire, memory_order_relaxed))
+                break;
+            continue;
         }
-        fclose(f);
+
+        struct timespec now;
+        (void)ptz_now_monotonic(&now);
+        if (s != seen) {
+            seen = s;
+            since = now;
+        } else {
+            /* A live writer is never displaced, however long it is descheduled. Without a pid the holder
+               either died right after its CAS or has not stored it yet, so give it much longer. */
+            bool anon = atomic_load_explicit(&st->writer_pid, memory_order_relaxed) <= 0;
+            struct timespec limit = ptz_timespec_add_us(since, (anon ? STATE_ANON_MS : STATE_STEAL_MS) * 1000L);
+            /* Take over from a dead writer: s -> s + 2 keeps seq odd, now owned by us. */
+            if (ptz_timespec_ge(&now, &limit) && state_writer_gone(st) &&
+                atomic_compare_exchange_strong_explicit(&st->seq, &s, s + 2u,
+                                                        memory_order_acquire, memory_order_relaxed))
+                break;
+        }
+        sched_yield();
     }
+    atomic_store_explicit(&st->writer_boot, state_boot_id(), memory_order_relaxed);
+    atomic_store_explicit(&st->writer_pid, (int32_t)getpid(), memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
 
-    *pan_deg = x;
-    *tilt_deg = y;
-    *zoom = z;
+static void state_write_end(struct ptz_state_shm *st) {
+    st->crc = state_checksum(st);
+    atomic_store_explicit(&st->writer_pid, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->seq, 1u, memory_order_release);
+}
+
+static int state_read(const struct ptz_state_shm *st, int *x, int *y, int *z) {
+    struct ptz_state_shm *w = (struct ptz_state_shm *)st;
+
+    for (int i = 0; i < STATE_SPIN_MAX; i++) {
+        uint32_t s1 = atomic_load_explicit(&w->seq, memory_order_acquire);
+        if (s1 & 1u) {
+            if (i > 64) sched_yield();
+            continue;
+        }
+
+        int32_t px = st->pan, py = st->tilt, pz = st->zoom;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&w->seq, memory_order_relaxed) != s1) continue;
+
+        *x = px;
+        *y = py;
+        *z = pz;
+        return 0;
+    }
+
+    /* Writer stuck mid-update: accept the payload only if it is self-consistent. */
+    if (st->crc != state_checksum(st)) return -1;
+    *x = st->pan;
+    *y = st->tilt;
+    *z = st->zoom;
     return 0;
 }
 
-int ptz_set_position(const ptz_ctx_t *ctx, int pan_deg, int tilt_deg, int zoom) {
+static int read_position_text(const ptz_config_t *cfg, int *x, int *y, int *z) {
+    char path[512];
+    ptz_state_path(cfg, "ptz_position", path, sizeof(path));
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int rc = (fscanf(f, "%d,%d,%d", x, y, z) == 3) ? 0 : -1;
+    fclose(f);
+    return rc;
+}
+
+static int write_position_text(const ptz_config_t *cfg, int x, int y, int z) {
+    char path[512];
+    char tmp[520];
+    ptz_state_path(cfg, "ptz_position", path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    fprintf(f, "%d,%d,%d\n", x, y, z);
+    if (fclose(f) != 0) return -1;
+
+    /* rename() keeps readers from ever seeing a half-written file. */
+    return rename(tmp, path);
+}
+
+static int64_t round_q16(int64_t v) {
+    return (v >= 0) ? (v + 0x8000) >> 16 : -((-v + 0x8000) >> 16);
+}
+
+void ptz_kin_init(ptz_ctx_t *ctx) {
+    if (!ctx) return;
+    const ptz_config_t *cfg = &ctx->cfg;
+
+    for (int a = 0; a < 2; a++) {
+        int total = (a == PTZ_AXIS_PAN) ? cfg->pan_total_steps : cfg->tilt_total_steps;
+        int max_deg = (a == PTZ_AXIS_PAN) ? cfg->pan_max_deg : cfg->tilt_max_deg;
+        if (total < 1) total = 1;
+        if (max_deg < 1) max_deg = 1;
+
+        ctx->kin[a].total_steps = total;
+        ctx->kin[a].max_deg = max_deg;
+        ctx->kin[a].invert = (a == PTZ_AXIS_PAN) ? cfg->pan_invert != 0 : cfg->tilt_invert != 0;
+        ctx->kin[a].steps_per_deg_q16 = (uint32_t)((((uint64_t)total << 16) + (uint64_t)max_deg / 2) / (uint64_t)max_deg);
+        ctx->kin[a].deg_per_step_q16 = (uint32_t)((((uint64_t)max_deg << 16) + (uint64_t)total / 2) / (uint64_t)total);
+    }
+}
+
+int ptz_deg_to_steps(const ptz_ctx_t *ctx, ptz_axis_t a, int deg) {
+    return (int)round_q16((int64_t)deg * ctx->kin[a].steps_per_deg_q16);
+}
+
+int ptz_steps_to_deg(const ptz_ctx_t *ctx, ptz_axis_t a, int steps) {
+    return (int)round_q16((int64_t)steps * ctx->kin[a].deg_per_step_q16);
+}
+
+int ptz_norm_to_steps(const ptz_ctx_t *ctx, ptz_axis_t a, double v) {
+    int total = ctx->kin[a].total_steps;
+    return ptz_clampi((int)((v + 1.0) * 0.5 * total + 0.5), 0, total);
+}
+
+int ptz_state_open(ptz_ctx_t *ctx) {
     if (!ctx) return -1;
+    ctx->state = NULL;
 
     char path[512];
-    ptz_state_path(&ctx->cfg, "ptz_position", path, sizeof(path));
+    ptz_state_path(&ctx->cfg, "ptz_state.bin", path, sizeof(path));
 
-    ptz_ensure_state_dir(&ctx->cfg);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
 
-    FILE *f = fopen(path, "w");
-    if (!f) return -1;
-    fprintf(f, "%d,%d,%d\n", pan_deg, tilt_deg, zoom);
-    fclose(f);
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 ||
+        (sb.st_size < (off_t)sizeof(struct ptz_state_shm) &&
+         ftruncate(fd, (off_t)sizeof(struct ptz_state_shm)) != 0)) {
+        close(fd);
+        return -1;
+    }
+
+    void *m = mmap(NULL, sizeof(struct ptz_state_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+
+    struct ptz_state_shm *st = (struct ptz_state_shm *)m;
+    ctx->state = st;
+
+    bool intact = atomic_load_explicit(&st->magic, memory_order_acquire) == STATE_MAGIC &&
+                  !(atomic_load_explicit(&st->seq, memory_order_relaxed) & 1u) &&
+                  st->crc == state_checksum(st);
+    if (intact && st->version == STATE_VERSION) return 0;
+
+    if (intact && (st->version == 2u || st->version == 3u)) {
+        /* Same payload; the fields added since were zero-filled by ftruncate(). */
+        state_write_begin(st);
+        st->version = STATE_VERSION;
+        state_write_end(st);
+        return 0;
+    }
+
+    /* v1 stored degrees; new, torn after power loss or unknown: seed from the text export if there is one. */
+    int x = DEFAULT_PAN_DEG, y = DEFAULT_TILT_DEG, z = 0;
+    if (intact && st->version == 1u) {
+        x = st->pan; y = st->tilt; z = st->zoom;
+    } else if (read_position_text(&ctx->cfg, &x, &y, &z) != 0) {
+        x = DEFAULT_PAN_DEG; y = DEFAULT_TILT_DEG; z = 0;
+    }
+
+    state_write_begin(st);
+    st->version = STATE_VERSION;
+    st->pan = ptz_clampi(ptz_deg_to_steps(ctx, PTZ_AXIS_PAN, x), 0, ctx->kin[PTZ_AXIS_PAN].total_steps);
+    st->tilt = ptz_clampi(ptz_deg_to_steps(ctx, PTZ_AXIS_TILT, y), 0, ctx->kin[PTZ_AXIS_TILT].total_steps);
+    st->zoom = z;
+    state_write_end(st);
+    atomic_store_explicit(&st->magic, STATE_MAGIC, memory_order_release);
     return 0;
 }
 
-int ptz_move_preset(ptz_ctx_t *ctx, const char *preset_id) {
-    if (!ctx || !preset_id || !*preset_id) return -1;
-
-    char ppath[512];
-    ptz_state_path(&ctx->cfg, "ptz_presets.db", ppath, sizeof(ppath));
+void ptz_state_close(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->state) return;
+    (void)munmap(ctx->state, sizeof(struct ptz_state_shm));
+    ctx->state = NULL;
+}
 
-    FILE *f = fopen(ppath, "r");
-    if (!f) {
-        ptz_log_line(&ctx->cfg, "preset %s not found", preset_id);
-        return 1;
+/* Without the mapping, position lives only in the text export (degrees). */
+static int text_get_steps(const ptz_ctx_t *ctx, int *pan, int *tilt, int *zoom) {
+    int x = DEFAULT_PAN_DEG, y = DEFAULT_TILT_DEG, z = 0;
+    if (read_position_text(&ctx->cfg, &x, &y, &z) != 0) {
+        x = DEFAULT_PAN_DEG; y = DEFAULT_TILT_DEG; z = 0;
     }
+    *pan = ptz_deg_to_steps(ctx, PTZ_AXIS_PAN, x);
+    *tilt = ptz_deg_to_steps(ctx, PTZ_AXIS_TILT, y);
+    *zoom = z;
+    return 0;
+}
 
-    int wanted = atoi(preset_id);
+static int text_put_steps(const ptz_ctx_t *ctx, int pan, int tilt, int zoom) {
+    ptz_ensure_state_dir(&ctx->cfg);
+    return (write_position_text(&ctx->cfg, ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, pan),
+                                ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, tilt), zoom) == 0) ? 0 : -1;
+}
 
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-        int id, px, py, pz;
-        char name[128];
+int ptz_get_position_steps(const ptz_ctx_t *ctx, int *pan, int *tilt, int *zoom) {
+    if (!ctx || !pan || !tilt || !zoom) return -1;
+    if (ctx->state && state_read(ctx->state, pan, tilt, zoom) == 0) return 0;
+    return text_get_steps(ctx, pan, tilt, zoom);
+}
 
-        if (sscanf(line, "%d,%127[^,],%d,%d,%d", &id, name, &px, &py, &pz) == 5 && id == wanted) {
-            fclose(f);
-            (void)ptz_set_position(ctx, px, py, pz);
-            ptz_log_line(&ctx->cfg, "move preset=%d -> pos=%d,%d,%d", id, px, py, pz);
-            return 0;
-        }
+int ptz_set_position_steps(const ptz_ctx_t *ctx, int pan, int tilt, int zoom) {
+    if (!ctx) return -1;
+
+    if (ctx->state) {
+        state_write_begin(ctx->state);
+        ctx->state->pan = pan;
+        ctx->state->tilt = tilt;
+        ctx->state->zoom = zoom;
+        state_write_end(ctx->state);
+
+        if (!ctx->cfg.position_text_export) return 0;
     }
+    return text_put_steps(ctx, pan, tilt, zoom);
+}
 
-    fclose(f);
-    ptz_log_line(&ctx->cfg, "preset %s not found", preset_id);
-    return 1;
+int ptz_add_position_steps(const ptz_ctx_t *ctx, int dpan, int dtilt) {
+    if (!ctx) return -1;
+
+    if (!ctx->state) {
+        int p, t, z;
+        (void)text_get_steps(ctx, &p, &t, &z);
+        return text_put_steps(ctx, ptz_clampi(p + dpan, 0, ctx->kin[PTZ_AXIS_PAN].total_steps),
+                              ptz_clampi(t + dtilt, 0, ctx->kin[PTZ_AXIS_TILT].total_steps), z);
+    }
+
+    /* Read and write inside one write section, so concurrent adds from other processes are not lost. */
+    state_write_begin(ctx->state);
+    ctx->state->pan = ptz_clampi(ctx->state->pan + dpan, 0, ctx->kin[PTZ_AXIS_PAN].total_steps);
+    ctx->state->tilt = ptz_clampi(ctx->state->tilt + dtilt, 0, ctx->kin[PTZ_AXIS_TILT].total_steps);
+    state_write_end(ctx->state);
+    return 0;
+}
+
+int ptz_export_position(const ptz_ctx_t *ctx) {
+    if (!ctx || (ctx->state && !ctx->cfg.position_text_export)) return 0;
+
+    int p, t, z;
+    if (ptz_get_position_steps(ctx, &p, &t, &z) != 0) return -1;
+    return text_put_steps(ctx, p, t, z);
+}
+
+int ptz_get_position(const ptz_ctx_t *ctx, int *pan_deg, int *tilt_deg, int *zoom) {
+    if (!ctx || !pan_deg || !tilt_deg || !zoom) return -1;
+
+    int p, t;
+    if (ptz_get_position_steps(ctx, &p, &t, zoom) != 0) return -1;
+    *pan_deg = ptz_steps_to_deg(ctx, PTZ_AXIS_PAN, p);
+    *tilt_deg = ptz_steps_to_deg(ctx, PTZ_AXIS_TILT, t);
+    return 0;
+}
+
+int ptz_set_position(const ptz_ctx_t *ctx, int pan_deg, int tilt_deg, int zoom) {
+    if (!ctx) return -1;
+    return ptz_set_position_steps(ctx, ptz_deg_to_steps(ctx, PTZ_AXIS_PAN, pan_deg),
+                                  ptz_deg_to_steps(ctx, PTZ_AXIS_TILT, tilt_deg), zoom);
+}
+
+void ptz_motion_claim(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->state) return;
+
+    state_write_begin(ctx->state);
+    int32_t prev = atomic_load_explicit(&ctx->state->owner_pid, memory_order_relaxed);
+    uint32_t gen = atomic_load_explicit(&ctx->state->motion_gen, memory_order_relaxed) + 1u;
+    atomic_store_explicit(&ctx->state->owner_pid, (int32_t)getpid(), memory_order_relaxed);
+    atomic_store_explicit(&ctx->state->motion_gen, gen, memory_order_release);
+    state_write_end(ctx->state);
+
+    ctx->motion_gen = gen;
+    if (prev && prev != (int32_t)getpid()) PTZ_LOGD(&ctx->cfg, "motion owner %d -> %d gen=%u", prev, (int)getpid(), gen);
+}
+
+bool ptz_motion_superseded(const ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->state) return false;
+    return atomic_load_explicit(&ctx->state->motion_gen, memory_order_acquire) != ctx->motion_gen;
 }
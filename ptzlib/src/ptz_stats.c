@@ -0,0 +1,175 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Built-in instrumentation, rendered in the Prometheus text format by ptz_stats_format().
+
+   One set per process, like the logger: the library is single-threaded, so the hooks are plain increments
+   plus a log2 bucket index, and ioctl timing costs two vDSO clock reads next to a syscall. Histograms count
+   microseconds in power-of-two buckets (<= 1us, <= 2us, ... <= ~1s, +Inf). Building with -DPTZ_STATS=0 turns
+   every hook into a no-op. */
+
+#define HIST_BUCKETS (PTZ_STATS_BUCKETS + 1) /* + Inf */
+
+typedef struct {
+    uint64_t bucket[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+} hist_t;
+
+static struct {
+    hist_t ioctl[2][PTZ_STAT_NCMD];
+    uint64_t ioctl_errors[2][PTZ_STAT_NCMD];
+    hist_t tick_late[PTZ_STAT_NLOOP];
+    uint64_t catchup_skips[PTZ_STAT_NLOOP];
+    uint64_t open_failures[2];
+    uint64_t log_lines;
+    uint64_t log_bytes;
+    hist_t cmdq_queued;
+    uint64_t cmdq_coalesced;
+} g_stats;
+
+static const char *const CMD_NAMES[PTZ_STAT_NCMD] = { "move", "stop", "set_speed", "turn_middle", "get_state", "other" };
+static const char *const LOOP_NAMES[PTZ_STAT_NLOOP] = { "continuous", "move" };
+
+static void hist_add(hist_t *h, long long ns) {
+    if (ns < 0) ns = 0;
+    unsigned long long us = (unsigned long long)(ns + 999) / 1000ULL;
+    int i = (us <= 1) ? 0 : 64 - __builtin_clzll(us - 1);
+    if (i > PTZ_STATS_BUCKETS) i = PTZ_STATS_BUCKETS;
+    h->bucket[i]++;
+    h->count++;
+    h->sum_ns += (uint64_t)ns;
+}
+
+ptz_stat_cmd_t ptz_stats_cmd(const ptz_config_t *cfg, unsigned long cmd) {
+    if (cmd == cfg->ioctl_move) return PTZ_STAT_MOVE;
+    if (cmd == cfg->ioctl_stop) return PTZ_STAT_STOP;
+    if (cmd == cfg->ioctl_set_speed) return PTZ_STAT_SET_SPEED;
+    if (cmd == cfg->ioctl_turn_middle) return PTZ_STAT_TURN_MIDDLE;
+    if (cmd == cfg->ioctl_get_state) return PTZ_STAT_GET_STATE;
+    return PTZ_STAT_OTHER;
+}
+
+const char *ptz_stats_cmd_name(ptz_stat_cmd_t cmd) {
+    return ((unsigned)cmd < PTZ_STAT_NCMD) ? CMD_NAMES[cmd] : "other";
+}
+
+void ptz_stats_ioctl(ptz_axis_t axis, ptz_stat_cmd_t cmd, long long ns, bool failed) {
+    hist_add(&g_stats.ioctl[axis][cmd], ns);
+    if (failed) g_stats.ioctl_errors[axis][cmd]++;
+}
+
+void ptz_stats_tick(ptz_stat_loop_t loop, const struct timespec *due, const struct timespec *now) {
+    long long ns = (long long)(now->tv_sec - due->tv_sec) * 1000000000LL + (now->tv_nsec - due->tv_nsec);
+    hist_add(&g_stats.tick_late[loop], ns);
+}
+
+void ptz_stats_catchup_skip(ptz_stat_loop_t loop) { g_stats.catchup_skips[loop]++; }
+void ptz_stats_open_failure(ptz_axis_t axis) { g_stats.open_failures[axis]++; }
+
+void ptz_stats_logged(size_t bytes) {
+    g_stats.log_lines++;
+    g_stats.log_bytes += bytes;
+}
+
+void ptz_stats_cmdq(long long queued_ns, bool coalesced) {
+    if (coalesced) g_stats.cmdq_coalesced++;
+    else hist_add(&g_stats.cmdq_queued, queued_ns);
+}
+
+void ptz_stats_reset(void) { memset(&g_stats, 0, sizeof(g_stats)); }
+
+typedef struct {
+    char *buf;
+    size_t sz;
+    size_t used;
+    bool truncated;
+} out_t;
+
+static void emit(out_t *o, const char *fmt, ...) {
+    if (o->truncated) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + o->used, o->sz - o->used, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= o->sz - o->used) {
+        o->truncated = true;
+        o->buf[o->used] = '\0';
+        return;
+    }
+    o->used += (size_t)n;
+}
+
+/* Series with no observations are left out to keep the page short. */
+static void emit_hist(out_t *o, const char *name, const char *labels, const hist_t *h) {
+    if (!h->count) return;
+    uint64_t cum = 0;
+    for (int i = 0; i < PTZ_STATS_BUCKETS; i++) {
+        cum += h->bucket[i];
+        emit(o, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels, (double)(1UL << i) * 1e-6, (unsigned long long)cum);
+    }
+    emit(o, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels, (unsigned long long)h->count);
+    emit(o, "%s_sum{%s} %.9f\n", name, labels, (double)h->sum_ns * 1e-9);
+    emit(o, "%s_count{%s} %llu\n", name, labels, (unsigned long long)h->count);
+}
+
+int ptz_stats_format(char *out, size_t out_sz) {
+    if (!out || !out_sz) return -1;
+    out_t o = { out, out_sz, 0, false };
+    out[0] = '\0';
+    char labels[64];
+
+    emit(&o, "# HELP ptz_ioctl_seconds Motor driver ioctl latency.\n# TYPE ptz_ioctl_seconds histogram\n");
+    for (int a = 0; a < 2; a++) {
+        for (int c = 0; c < PTZ_STAT_NCMD; c++) {
+            snprintf(labels, sizeof(labels), "axis=\"%s\",cmd=\"%s\"", ptz_axis_name((ptz_axis_t)a), CMD_NAMES[c]);
+            emit_hist(&o, "ptz_ioctl_seconds", labels, &g_stats.ioctl[a][c]);
+        }
+    }
+
+    emit(&o, "# HELP ptz_ioctl_errors_total Motor driver ioctls that failed.\n# TYPE ptz_ioctl_errors_total counter\n");
+    for (int a = 0; a < 2; a++) {
+        for (int c = 0; c < PTZ_STAT_NCMD; c++) {
+            if (!g_stats.ioctl_errors[a][c]) continue;
+            emit(&o, "ptz_ioctl_errors_total{axis=\"%s\",cmd=\"%s\"} %llu\n", ptz_axis_name((ptz_axis_t)a),
+                 CMD_NAMES[c], (unsigned long long)g_stats.ioctl_errors[a][c]);
+        }
+    }
+
+    emit(&o, "# HELP ptz_tick_lateness_seconds How late ptz_tick() ran work after it was due.\n"
+             "# TYPE ptz_tick_lateness_seconds histogram\n");
+    for (int l = 0; l < PTZ_STAT_NLOOP; l++) {
+        snprintf(labels, sizeof(labels), "loop=\"%s\"", LOOP_NAMES[l]);
+        emit_hist(&o, "ptz_tick_lateness_seconds", labels, &g_stats.tick_late[l]);
+    }
+
+    emit(&o, "# HELP ptz_tick_catchup_skips_total Late ticks that skipped or merged missed periods instead of bursting.\n"
+             "# TYPE ptz_tick_catchup_skips_total counter\n");
+    for (int l = 0; l < PTZ_STAT_NLOOP; l++)
+        emit(&o, "ptz_tick_catchup_skips_total{loop=\"%s\"} %llu\n", LOOP_NAMES[l],
+             (unsigned long long)g_stats.catchup_skips[l]);
+
+    emit(&o, "# HELP ptz_motor_open_failures_total Failed attempts to open a motor device.\n"
+             "# TYPE ptz_motor_open_failures_total counter\n");
+    for (int a = 0; a < 2; a++)
+        emit(&o, "ptz_motor_open_failures_total{axis=\"%s\"} %llu\n", ptz_axis_name((ptz_axis_t)a),
+             (unsigned long long)g_stats.open_failures[a]);
+
+    emit(&o, "# HELP ptz_log_lines_total Lines written to the log buffer.\n# TYPE ptz_log_lines_total counter\n"
+             "ptz_log_lines_total %llu\n", (unsigned long long)g_stats.log_lines);
+    emit(&o, "# HELP ptz_log_bytes_total Bytes written to the log buffer.\n# TYPE ptz_log_bytes_total counter\n"
+             "ptz_log_bytes_total %llu\n", (unsigned long long)g_stats.log_bytes);
+
+    emit(&o, "# HELP ptz_cmdq_queued_seconds Time from pushing a command onto the shared ring to applying it.\n"
+             "# TYPE ptz_cmdq_queued_seconds histogram\n");
+    emit_hist(&o, "ptz_cmdq_queued_seconds", "ring=\"cmdq\"", &g_stats.cmdq_queued);
+    emit(&o, "# HELP ptz_cmdq_coalesced_total Velocity updates from the ring dropped for a newer one.\n"
+             "# TYPE ptz_cmdq_coalesced_total counter\n"
+             "ptz_cmdq_coalesced_total %llu\n", (unsigned long long)g_stats.cmdq_coalesced);
+
+    return o.truncated ? -1 : (int)o.used;
+}
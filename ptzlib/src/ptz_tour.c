@@ -0,0 +1,312 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Preset tour.
+
+   A patrol over up to PTZ_TOUR_MAX presets, run by ptz_tick() like any other move: each leg is an abs move started
+   with ptz_plan_start() and each dwell is a deadline in ctx->tour, so a long-lived process (ptzd) tours without
+   blocking and keeps answering requests in between. What a cycle needs is worked out once by ptz_tour_start():
+   the preset positions in steps, and per leg the step deltas, the trapezoidal profile and the travel time.
+
+   The travel time is also what the stops are ordered by: nearest neighbour from the first stop, then 2-opt
+   (reverse a stretch of the cycle while that shortens it), then rotated to start at the stop closest to the head.
+   Time rather than distance, because pan and tilt move at once at different rates: a leg costs what its slower
+   axis needs, and a long pan can be cheaper than a short tilt.
+
+   Any other motion command ends the tour: ptz_stop(), a newer move (ctx->move.id no longer ours), a direction or
+   velocity move (ctx->cont armed), another process (motion claim). A leg cut short otherwise, by a config reload
+   that changed the calibration, is restarted from where the head got to. */
+
+#define TOUR_DWELL_DEFAULT_MS 5000
+#define TOUR_RETRIES_MAX      2
+
+static int prev_stop(const ptz_ctx_t *ctx, int i) { return (i + ctx->tour.n - 1) % ctx->tour.n; }
+
+/* Steps and profile of a move by delta[] (logical steps); returns its travel time. */
+static long leg_plan(const ptz_ctx_t *ctx, const int delta[2], bool *planned, ptz_profile_t *prof) {
+    int steps[2] = { abs(delta[0]), abs(delta[1]) };
+    *planned = ptz_plan_profile(&ctx->cfg, steps, prof);
+    return ptz_plan_travel_ms(ctx, steps, *planned ? prof : NULL);
+}
+
+static long leg_ms(const ptz_ctx_t *ctx, const int from[2], const int to[2]) {
+    int delta[2] = { to[0] - from[0], to[1] - from[1] };
+    bool planned;
+    ptz_profile_t prof;
+    return leg_plan(ctx, delta, &planned, &prof);
+}
+
+/* Preset degrees to steps, clamped like an abs move. */
+static void plan_targets(ptz_ctx_t *ctx) {
+    for (int i = 0; i < ctx->tour.n; i++) {
+        struct ptz_tour_stop *s = &ctx->tour.stop[i];
+        s->to[0] = ptz_clampi(ptz_deg_to_steps(ctx, PTZ_AXIS_PAN, s->pan_deg), 0, ctx->kin[PTZ_AXIS_PAN].total_steps);
+        s->to[1] = ptz_clampi(ptz_deg_to_steps(ctx, PTZ_AXIS_TILT, s->tilt_deg), 0, ctx->kin[PTZ_AXIS_TILT].total_steps);
+    }
+}
+
+/* Each stop's leg from the one before it, and the cycle time. */
+static void plan_legs(ptz_ctx_t *ctx) {
+    ctx->tour.cycle_ms = 0;
+    for (int i = 0; i < ctx->tour.n; i++) {
+        struct ptz_tour_stop *s = &ctx->tour.stop[i];
+        const struct ptz_tour_stop *p = &ctx->tour.stop[prev_stop(ctx, i)];
+        s->delta[0] = s->to[0] - p->to[0];
+        s->delta[1] = s->to[1] - p->to[1];
+        s->travel_ms = leg_plan(ctx, s->delta, &s->planned, &s->prof);
+        ctx->tour.cycle_ms += s->travel_ms + s->dwell_ms;
+    }
+}
+
+static long cycle_travel(long cost[PTZ_TOUR_MAX][PTZ_TOUR_MAX], const int *ord, int n) {
+    long ms = 0;
+    for (int i = 0; i < n; i++) ms += cost[ord[i]][ord[(i + 1) % n]];
+    return ms;
+}
+
+/* Shortest cycle we can find through the stops (travel time only; the dwells are the same in any order). */
+static void plan_order(long cost[PTZ_TOUR_MAX][PTZ_TOUR_MAX], int n, int *ord) {
+    bool used[PTZ_TOUR_MAX] = { false };
+    ord[0] = 0;
+    used[0] = true;
+    for (int k = 1; k < n; k++) {
+        int best = -1;
+        for (int j = 0; j < n; j++) {
+            if (!used[j] && (best < 0 || cost[ord[k - 1]][j] < cost[ord[k - 1]][best])) best = j;
+        }
+        ord[k] = best;
+        used[best] = true;
+    }
+
+    /* 2-opt: swapping edges a-b, c-d for a-c, b-d reverses b..c. Costs are symmetric, so only the two edges change. */
+    for (bool better = true; better;) {
+        better = false;
+        for (int i = 0; i + 2 < n; i++) {
+            for (int j = i + 2; j < n; j++) {
+                if (i == 0 && j == n - 1) continue; /* the two edges share ord[0] */
+                int a = ord[i], b = ord[i + 1], c = ord[j], d = ord[(j + 1) % n];
+                if (cost[a][c] + cost[b][d] >= cost[a][b] + cost[c][d]) continue;
+                for (int l = i + 1, r = j; l < r; l++, r--) {
+                    int t = ord[l];
+                    ord[l] = ord[r];
+                    ord[r] = t;
+                }
+                better = true;
+            }
+        }
+    }
+}
+
+/* Start the leg into stop i: the precomputed one when the head is at the previous stop, else from where it is. */
+static int go(ptz_ctx_t *ctx, int i) {
+    const struct ptz_tour_stop *s = &ctx->tour.stop[i];
+    const struct ptz_tour_stop *p = &ctx->tour.stop[prev_stop(ctx, i)];
+
+    int pos[3];
+    (void)ptz_get_position_steps(ctx, &pos[0], &pos[1], &pos[2]);
+
+    int delta[2] = { s->delta[0], s->delta[1] };
+    const ptz_profile_t *prof = s->planned ? &s->prof : NULL;
+    ptz_profile_t live;
+    if (pos[0] != p->to[0] || pos[1] != p->to[1]) {
+        bool planned;
+        delta[0] = s->to[0] - pos[0];
+        delta[1] = s->to[1] - pos[1];
+        (void)leg_plan(ctx, delta, &planned, &live);
+        prof = planned ? &live : NULL;
+    }
+
+    ptz_dir_t px = (delta[0] < 0) ? PTZ_DIR_LEFT : PTZ_DIR_RIGHT, ty = (delta[1] < 0) ? PTZ_DIR_DOWN : PTZ_DIR_UP;
+    ptz_plan_leg_t leg[2] = {
+        { abs(delta[0]), ctx->dirs[px].polarity, px },
+        { abs(delta[1]), ctx->dirs[ty].polarity, ty },
+    };
+    ctx->tour.cur = i;
+    ctx->tour.dwelling = false;
+    if (ptz_plan_start(ctx, leg, s->to, prof) != 0) return -1;
+    ctx->tour.move_id = ctx->move.id;
+    (void)ptz_ctx_now(ctx, &ctx->tour.next_due); /* a leg with nothing to move arrives at once */
+
+    ptz_log_line(&ctx->cfg, "tour -> preset %d (%d/%d) pos=%d,%d,%d", s->preset, i + 1, ctx->tour.n, s->pan_deg,
+                 s->tilt_deg, s->to[2]);
+    return 0;
+}
+
+void ptz_tour_end(ptz_ctx_t *ctx, const char *why) {
+    if (!ctx || !ctx->tour.active) return;
+    ctx->tour.active = false;
+    if (why) ptz_log_line(&ctx->cfg, "tour %s at preset %d after %ld cycles", why,
+                          ctx->tour.stop[ctx->tour.cur].preset, ctx->tour.cycles);
+}
+
+void ptz_tour_replan(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->tour.active) return;
+    plan_targets(ctx);
+    plan_legs(ctx);
+    ptz_log_line(&ctx->cfg, "tour replanned, cycle=%ldms", ctx->tour.cycle_ms);
+}
+
+int ptz_tour_start(ptz_ctx_t *ctx, const ptz_tour_spot_t *spots, int n, bool optimize) {
+    if (!ctx || !spots || n < 1 || n > PTZ_TOUR_MAX) return -1;
+
+    ptz_preset_t list[PTZ_PRESET_MAX];
+    int np = ptz_preset_list(ctx, list, PTZ_PRESET_MAX);
+    if (np < 0) return -1;
+
+    struct ptz_tour_stop given[PTZ_TOUR_MAX];
+    memset(given, 0, sizeof(given));
+    for (int i = 0; i < n; i++) {
+        const ptz_preset_t *p = NULL;
+        for (int j = 0; j < np && j < PTZ_PRESET_MAX && !p; j++) {
+            if (list[j].id == spots[i].preset) p = &list[j];
+        }
+        if (!p) {
+            ptz_log_line(&ctx->cfg, "tour: preset %d not found", spots[i].preset);
+            return 1;
+        }
+        given[i].preset = p->id;
+        given[i].dwell_ms = (spots[i].dwell_ms > 0) ? spots[i].dwell_ms : 0;
+        given[i].pan_deg = p->pan_deg;
+        given[i].tilt_deg = p->tilt_deg;
+        given[i].to[2] = ptz_clampi(p->zoom, 0, 100);
+    }
+
+    ptz_tour_end(ctx, "replaced");
+    ctx->tour.n = n;
+    memcpy(ctx->tour.stop, given, sizeof(given));
+    plan_targets(ctx);
+    memcpy(given, ctx->tour.stop, sizeof(given));
+
+    long cost[PTZ_TOUR_MAX][PTZ_TOUR_MAX];
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) cost[i][j] = (i == j) ? 0 : leg_ms(ctx, ctx->tour.stop[i].to, ctx->tour.stop[j].to);
+    }
+
+    int ord[PTZ_TOUR_MAX], first = 0;
+    for (int i = 0; i < n; i++) ord[i] = i;
+    long given_ms = cycle_travel(cost, ord, n);
+    if (optimize && n > 2) plan_order(cost, n, ord);
+
+    if (optimize) {
+        int pos[3];
+        (void)ptz_get_position_steps(ctx, &pos[0], &pos[1], &pos[2]);
+        long best = -1;
+        for (int k = 0; k < n; k++) {
+            long ms = leg_ms(ctx, pos, ctx->tour.stop[ord[k]].to);
+            if (best < 0 || ms < best) {
+                best = ms;
+                first = k;
+            }
+        }
+    }
+    for (int k = 0; k < n; k++) ctx->tour.stop[k] = given[ord[(first + k) % n]];
+    plan_legs(ctx);
+
+    char order[PTZ_TOUR_MAX * 4];
+    size_t used = 0;
+    order[0] = '\0';
+    for (int k = 0; k < n && used < sizeof(order); k++)
+        used += (size_t)snprintf(order + used, sizeof(order) - used, "%s%d", k ? "," : "", ctx->tour.stop[k].preset);
+    ptz_log_line(&ctx->cfg, "tour start order=%s travel=%ldms (as given %ldms) cycle=%ldms", order,
+                 cycle_travel(cost, ord, n), given_ms, ctx->tour.cycle_ms);
+
+    ctx->tour.active = true;
+    ctx->tour.cycles = 0;
+    ctx->tour.retries = 0;
+    if (go(ctx, 0) != 0) {
+        ctx->tour.active = false;
+        return -1;
+    }
+    return 0;
+}
+
+void ptz_tour_stop(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->tour.active) return;
+    ptz_tour_end(ctx, "stopped");
+    ptz_plan_preempt(ctx);
+}
+
+int ptz_tour_tick(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->tour.active) return 0;
+
+    if (ctx->move.id != ctx->tour.move_id || ctx->cont[PTZ_AXIS_PAN].active || ctx->cont[PTZ_AXIS_TILT].active) {
+        ptz_tour_end(ctx, "interrupted by another move");
+        return 0;
+    }
+    if (ctx->move.active) return 0;
+    if (ctx->move.failed) {
+        ptz_tour_end(ctx, "failed");
+        return 0;
+    }
+
+    struct timespec now;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+    const struct ptz_tour_stop *s = &ctx->tour.stop[ctx->tour.cur];
+
+    if (!ctx->tour.dwelling) {
+        int pos[3];
+        (void)ptz_get_position_steps(ctx, &pos[0], &pos[1], &pos[2]);
+        if (pos[0] != s->to[0] || pos[1] != s->to[1]) {
+            /* Cut short without a new owner (a config reload): go again from here. */
+            if (ctx->tour.retries++ >= TOUR_RETRIES_MAX) {
+                ptz_tour_end(ctx, "gave up");
+                return 0;
+            }
+            return (go(ctx, ctx->tour.cur) == 0) ? 0 : -1;
+        }
+        ctx->tour.retries = 0;
+        ctx->tour.dwelling = true;
+        ctx->tour.next_due = ptz_timespec_add_us(now, (long)s->dwell_ms * 1000L);
+        PTZ_LOGD(&ctx->cfg, "tour at preset %d, dwell %dms", s->preset, s->dwell_ms);
+        return 0;
+    }
+
+    if (!ptz_timespec_ge(&now, &ctx->tour.next_due)) return 0;
+    int next = (ctx->tour.cur + 1) % ctx->tour.n;
+    if (next == 0) ctx->tour.cycles++;
+    return (go(ctx, next) == 0) ? 0 : -1;
+}
+
+int ptz_tour_status(const ptz_ctx_t *ctx, ptz_tour_status_t *st) {
+    if (!ctx || !st) return -1;
+    memset(st, 0, sizeof(*st));
+
+    st->active = ctx->tour.active;
+    st->dwelling = ctx->tour.active && ctx->tour.dwelling;
+    st->n = ctx->tour.n;
+    st->cycles = ctx->tour.cycles;
+    st->cycle_ms = ctx->tour.cycle_ms;
+    if (ctx->tour.n > 0) st->preset = ctx->tour.stop[ctx->tour.cur].preset;
+    for (int i = 0; i < ctx->tour.n; i++) st->order[i] = ctx->tour.stop[i].preset;
+    return st->active ? 1 : 0;
+}
+
+int ptz_tour_parse(const char *list, ptz_tour_spot_t *out, int max) {
+    if (!list || !out) return -1;
+
+    int n = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p || n >= max) return -1;
+
+        double dwell_s = TOUR_DWELL_DEFAULT_MS / 1000.0;
+        if (*end == ':') {
+            p = end + 1;
+            dwell_s = strtod(p, &end);
+            if (end == p || dwell_s < 0.0 || dwell_s > 86400.0) return -1;
+        }
+        if (*end && *end != ',') return -1;
+
+        out[n].preset = (int)id;
+        out[n].dwell_ms = (int)(dwell_s * 1000.0 + 0.5);
+        n++;
+        p = *end ? end + 1 : end;
+    }
+    return n;
+}
@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Motor command trace.
+
+   TRACE_FILE (default /tmp/ptz_trace.bin, on tmpfs rather than the SD card) holds a fixed-size ring that every
+   context maps MAP_SHARED, like ptz_state.bin. ptz_issue_motor() appends one record per call: a writer claims
+   an index with one atomic add, clears the record's seq, fills it in and publishes seq = index + 1. A reader
+   keeps a record only if seq matches its index before and after copying it, so a record that was being
+   overwritten is dropped rather than torn. The cost per command is two clock reads and a 48-byte store.
+
+   ptztrace dumps the ring, saves it as a snapshot (the same layout, nrec = head = count) and replays it. */
+
+#define TRACE_MAGIC       0x52545a50u /* "PTZR" */
+#define TRACE_VERSION     1u
+#define TRACE_RECORDS_MAX (1u << 20)
+
+_Static_assert(sizeof(struct ptz_trace_rec) == 48, "trace record layout changed: bump TRACE_VERSION");
+
+static int32_t g_pid; /* getpid() is a syscall; the library never forks */
+
+static size_t trace_size(uint32_t nrec) {
+    return sizeof(struct ptz_trace_shm) + (size_t)nrec * sizeof(struct ptz_trace_rec);
+}
+
+static uint32_t round_pow2(uint32_t n) {
+    uint32_t p = 16;
+    while (p < n && p < TRACE_RECORDS_MAX) p <<= 1;
+    return p;
+}
+
+/* Header of an existing file, if it is a trace of this version that fits in `size` bytes. */
+static bool header_ok(const struct ptz_trace_shm *h, size_t size) {
+    return atomic_load_explicit(&((struct ptz_trace_shm *)h)->magic, memory_order_acquire) == TRACE_MAGIC &&
+           h->version == TRACE_VERSION && h->nrec > 0 && h->nrec <= TRACE_RECORDS_MAX &&
+           size >= trace_size(h->nrec);
+}
+
+int ptz_trace_open(ptz_ctx_t *ctx) {
+    if (!ctx) return -1;
+    ctx->trace = NULL;
+    ctx->trace_bytes = 0;
+
+    const ptz_config_t *cfg = &ctx->cfg;
+    if (!cfg->trace_file[0] || cfg->trace_records <= 0) return 0;
+
+    /* Usually in a shared /tmp: never follow a planted symlink, and keep the ring to its owner. */
+    int fd = open(cfg->trace_file, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+    if (fd < 0) return -1;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* An intact ring keeps its size even if TRACE_RECORDS changed: other processes may have it mapped, and
+       shrinking the file under them would fault. Deleting the file resizes it. */
+    uint32_t nrec = round_pow2((uint32_t)cfg->trace_records);
+    bool existing = false;
+    struct ptz_trace_shm hdr;
+    if ((size_t)sb.st_size >= sizeof(hdr) && pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+        header_ok(&hdr, (size_t)sb.st_size) && !(hdr.nrec & (hdr.nrec - 1))) {
+        if (hdr.nrec != nrec)
+            ptz_log_line(cfg, "trace %s keeps %u records (TRACE_RECORDS=%d); delete it to resize",
+                         cfg->trace_file, hdr.nrec, cfg->trace_records);
+        nrec = hdr.nrec;
+        existing = true;
+    }
+
+    size_t size = trace_size(nrec);
+    if (!existing && (size_t)sb.st_size < size && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+
+    struct ptz_trace_shm *t = (struct ptz_trace_shm *)m;
+    if (!existing) {
+        atomic_store_explicit(&t->magic, 0, memory_order_relaxed);
+        memset(t->rec, 0, (size_t)nrec * sizeof(t->rec[0]));
+        t->version = TRACE_VERSION;
+        t->nrec = nrec;
+        atomic_store_explicit(&t->head, 0, memory_order_relaxed);
+        atomic_store_explicit(&t->magic, TRACE_MAGIC, memory_order_release);
+    }
+
+    ctx->trace = t;
+    ctx->trace_bytes = size;
+    g_pid = (int32_t)getpid();
+    return 0;
+}
+
+void ptz_trace_close(ptz_ctx_t *ctx) {
+    if (!ctx || !ctx->trace) return;
+    (void)munmap(ctx->trace, ctx->trace_bytes);
+    ctx->trace = NULL;
+    ctx->trace_bytes = 0;
+}
+
+void ptz_trace_record(ptz_ctx_t *ctx, ptz_axis_t axis, unsigned long cmd, int step, int rep, int rc, int err,
+                      const struct timespec *t0) {
+    struct ptz_trace_shm *t = ctx->trace;
+    if (!t) return;
+
+    struct timespec t1;
+    (void)ptz_ctx_now(ctx, &t1);
+    long long lat_ns = (long long)(t1.tv_sec - t0->tv_sec) * 1000000000LL + (t1.tv_nsec - t0->tv_nsec);
+
+    uint32_t idx = atomic_fetch_add_explicit(&t->head, 1u, memory_order_relaxed);
+    struct ptz_trace_rec *r = &t->rec[idx & (t->nrec - 1u)];
+
+    atomic_store_explicit(&r->seq, 0u, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    r->pid = g_pid;
+    r->t_ns = (int64_t)t0->tv_sec * 1000000000LL + t0->tv_nsec;
+    r->cmd = (uint32_t)cmd;
+    r->axis = (int32_t)axis;
+    r->step = step;
+    r->rep = rep;
+    r->rc = rc;
+    r->err = rc ? err : 0;
+    r->lat_us = (lat_ns > 0) ? (uint32_t)(lat_ns / 1000) : 0u;
+    r->reserved = 0;
+    atomic_store_explicit(&r->seq, idx + 1u, memory_order_release);
+}
+
+/* Copy the records still in the ring, oldest first. */
+static int trace_copy(const struct ptz_trace_shm *t, ptz_trace_entry_t *out) {
+    struct ptz_trace_shm *w = (struct ptz_trace_shm *)t;
+    uint32_t head = atomic_load_explicit(&w->head, memory_order_acquire);
+    uint32_t count = (head < t->nrec) ? head : t->nrec;
+
+    int n = 0;
+    for (uint32_t i = head - count; i != head; i++) {
+        struct ptz_trace_rec *r = &w->rec[i % t->nrec];
+        if (atomic_load_explicit(&r->seq, memory_order_acquire) != i + 1u) continue;
+
+        ptz_trace_entry_t e = {
+            .pid = r->pid, .axis = (ptz_axis_t)r->axis, .t_ns = r->t_ns, .cmd = r->cmd, .step = r->step,
+            .rep = r->rep, .rc = r->rc, .err = r->err, .lat_us = r->lat_us,
+        };
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&r->seq, memory_order_relaxed) != i + 1u) continue;
+        if (e.axis != PTZ_AXIS_PAN && e.axis != PTZ_AXIS_TILT) continue;
+        out[n++] = e;
+    }
+    return n;
+}
+
+int ptz_trace_load(const char *path, ptz_trace_entry_t **out) {
+    if (!path || !out) return -1;
+    *out = NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(struct ptz_trace_shm)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = (size_t)sb.st_size;
+    void *m = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+
+    const struct ptz_trace_shm *t = (const struct ptz_trace_shm *)m;
+    int n = -1;
+    if (!header_ok(t, size)) {
+        errno = EINVAL;
+    } else if ((*out = malloc((size_t)t->nrec * sizeof(**out))) != NULL) {
+        n = trace_copy(t, *out);
+        if (!n) {
+            free(*out);
+            *out = NULL;
+        }
+    }
+    (void)munmap(m, size);
+    return n;
+}
+
+int ptz_trace_save(const char *path, const ptz_trace_entry_t *e, int n) {
+    if (!path || (!e && n) || n < 0 || (uint32_t)n > TRACE_RECORDS_MAX) return -1;
+
+    char tmp[520];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+
+    struct ptz_trace_shm hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    atomic_store_explicit(&hdr.magic, TRACE_MAGIC, memory_order_relaxed);
+    hdr.version = TRACE_VERSION;
+    hdr.nrec = n ? (uint32_t)n : 1u;
+    atomic_store_explicit(&hdr.head, (uint32_t)n, memory_order_relaxed);
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+
+    for (int i = 0; ok && i < (n ? n : 1); i++) {
+        struct ptz_trace_rec r;
+        memset(&r, 0, sizeof(r));
+        if (n) {
+            atomic_store_explicit(&r.seq, (uint32_t)i + 1u, memory_order_relaxed);
+            r.pid = e[i].pid;
+            r.t_ns = e[i].t_ns;
+            r.cmd = (uint32_t)e[i].cmd;
+            r.axis = (int32_t)e[i].axis;
+            r.step = e[i].step;
+            r.rep = e[i].rep;
+            r.rc = e[i].rc;
+            r.err = e[i].err;
+            r.lat_us = e[i].lat_us;
+        }
+        ok = fwrite(&r, sizeof(r), 1, f) == 1;
+    }
+
+    if (fclose(f) != 0) ok = false;
+    if (!ok) {
+        (void)remove(tmp);
+        return -1;
+    }
+    return rename(tmp, path);
+}
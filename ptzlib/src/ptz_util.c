@@ -21,6 +21,13 @@ void ptz_sleep_us(long us) {
     }
 }
 
+void ptz_sleep_until(const struct timespec *deadline) {
+    if (!deadline) return;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR) {
+        /* retry until the deadline */
+    }
+}
+
 int ptz_now_monotonic(struct timespec *out) {
     if (!out) return -1;
     return clock_gettime(CLOCK_MONOTONIC, out);
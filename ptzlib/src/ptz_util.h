@@ -5,6 +5,8 @@
 #include <time.h>
 
 void ptz_sleep_us(long us);
+/* Sleep until an absolute CLOCK_MONOTONIC time (no drift across repeated periods). */
+void ptz_sleep_until(const struct timespec *deadline);
 
 /* Monotonic time helpers (useful for event-loop driven control). */
 int ptz_now_monotonic(struct timespec *out);
@@ -1,8 +1,10 @@
 #define _POSIX_C_SOURCE 200809L
 #include "ptz_internal.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/timerfd.h>
 
 static long interval_us_from_cfg(const ptz_config_t *cfg) {
     int ms = cfg ? cfg->worker_interval_ms : 0;
@@ -11,23 +13,22 @@ static long interval_us_from_cfg(const ptz_config_t *cfg) {
     return (long)ms * 1000L;
 }
 
-int ptz_continuous_arm(ptz_ctx_t *ctx, ptz_axis_t a, const char *dir, int step, int rep) {
+int ptz_continuous_arm(ptz_ctx_t *ctx, ptz_axis_t a, ptz_dir_t dir, int step, int rep) {
     if (!ctx) return -1;
     if (a != PTZ_AXIS_PAN && a != PTZ_AXIS_TILT) return -1;
 
-    if (!dir) dir = "";
     if (rep < 1) rep = 1;
 
     ctx->cont[a].active = true;
     ctx->cont[a].step = step;
     ctx->cont[a].rep = rep;
     ctx->cont[a].fd_addr = ptz_axis_fd_addr(&ctx->cfg, a);
-
-    memset(ctx->cont[a].dir, 0, sizeof(ctx->cont[a].dir));
-    snprintf(ctx->cont[a].dir, sizeof(ctx->cont[a].dir), "%s", dir);
+    ctx->cont[a].interval_us = 0;
+    ctx->cont[a].speed = 0;
+    ctx->cont[a].dir = dir;
 
     struct timespec now;
-    if (ptz_now_monotonic(&now) != 0) {
+    if (ptz_ctx_now(ctx, &now) != 0) {
         now.tv_sec = 0;
         now.tv_nsec = 0;
     }
@@ -46,28 +47,36 @@ int ptz_continuous_tick(ptz_ctx_t *ctx) {
     if (!ctx) return -1;
 
     struct timespec now;
-    if (ptz_now_monotonic(&now) != 0) return -1;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
 
-    long interval_us = interval_us_from_cfg(&ctx->cfg);
+    long cfg_interval_us = interval_us_from_cfg(&ctx->cfg);
 
     int did = 0;
     for (int a = 0; a < 2; a++) {
         if (!ctx->cont[a].active) continue;
+        long interval_us = ctx->cont[a].interval_us ? ctx->cont[a].interval_us : cfg_interval_us;
         if (!ptz_timespec_ge(&now, &ctx->cont[a].next_due)) continue;
-
-        int rc = ptz_issue_motor(&ctx->cfg,
-                                (ptz_axis_t)a,
-                                ctx->cont[a].dir,
-                                ctx->cont[a].step,
-                                ctx->cont[a].rep,
-                                ctx->cfg.ioctl_move,
-                                true);
+        PTZ_STAT(ptz_stats_tick(PTZ_STAT_LOOP_CONTINUOUS, &ctx->cont[a].next_due, &now));
+
+        int rc = ptz_issue_motor(ctx,
+                                 (ptz_axis_t)a,
+                                 ptz_dir_name(ctx->cont[a].dir),
+                                 ctx->cont[a].step,
+                                 ctx->cont[a].rep,
+                                 ctx->cfg.ioctl_move,
+                                 true);
         if (rc != 0) return -1;
 
+        /* Position follows the step sent (back through the inversion to logical steps), once per tick:
+           repeats replace the target in flight rather than adding to it. */
+        int moved = ptz_drive_steps(ctx, (ptz_axis_t)a, ctx->cont[a].step);
+        (void)ptz_add_position_steps(ctx, (a == PTZ_AXIS_PAN) ? moved : 0, (a == PTZ_AXIS_TILT) ? moved : 0);
+
         ctx->cont[a].next_due = ptz_timespec_add_us(ctx->cont[a].next_due, interval_us);
         /* If we were paused for a while, don't try to catch up with a burst. */
         if (ptz_timespec_ge(&now, &ctx->cont[a].next_due)) {
             ctx->cont[a].next_due = ptz_timespec_add_us(now, interval_us);
+            PTZ_STAT(ptz_stats_catchup_skip(PTZ_STAT_LOOP_CONTINUOUS));
         }
 
         did = 1;
@@ -75,3 +84,154 @@ int ptz_continuous_tick(ptz_ctx_t *ctx) {
 
     return did;
 }
+
+/* Velocity mode.
+
+   A speed level (1..VEL_LEVELS) per axis sets the driver speed, and the faster axis sets the tick period: each
+   tick queues what each axis covers in one period, and the period grows as the speed drops (WORKER_INTERVAL_MS
+   at full speed, up to 1 s), so a slow pan costs a few ioctls per second instead of one per WORKER_INTERVAL_MS.
+   Both axes share the period and next_due, so a diagonal is issued from one tick. */
+#define VEL_LEVELS   32
+#define VEL_DEADBAND 0.01
+
+static int vel_full_speed(const ptz_config_t *cfg, ptz_axis_t a) {
+    int full = ptz_axis_speed_step(cfg, a);
+    if (full <= 0) full = ptz_axis_max_vel(cfg, a);
+    if (full <= 0) full = cfg->sim_step_rate;
+    return (full > 0) ? full : 1;
+}
+
+static int vel_level(double v) {
+    double mag = fabs(v);
+    return (mag < VEL_DEADBAND) ? 0 : (int)ceil(((mag > 1.0) ? 1.0 : mag) * VEL_LEVELS);
+}
+
+static int vel_axis(ptz_ctx_t *ctx, ptz_axis_t a, double v, int level, long interval_us, const struct timespec *now) {
+    const ptz_config_t *cfg = &ctx->cfg;
+    if (!level) {
+        if (!ctx->cont[a].active) return 0;
+        ptz_continuous_disarm(ctx, a);
+        return ptz_issue_motor(ctx, a, "", 0, 1, cfg->ioctl_stop, true);
+    }
+
+    int sign = (v < 0) ? -1 : 1;
+    ptz_dir_t dir = (a == PTZ_AXIS_PAN) ? ((sign > 0) ? PTZ_DIR_RIGHT : PTZ_DIR_LEFT)
+                                        : ((sign > 0) ? PTZ_DIR_UP : PTZ_DIR_DOWN);
+    int speed = vel_full_speed(cfg, a) * level / VEL_LEVELS;
+    if (speed < 1) speed = 1;
+
+    int step = (int)((long long)speed * interval_us / 1000000LL);
+    if (step < 1) step = 1;
+    int drive = ptz_drive_steps(ctx, a, sign * step);
+
+    if (!ctx->cont[a].active) {
+        if (ptz_continuous_arm(ctx, a, dir, drive, 1) != 0) return -1;
+    } else {
+        bool reverse = (ctx->cont[a].step < 0) != (drive < 0);
+        ctx->cont[a].step = drive;
+        ctx->cont[a].dir = dir;
+        if (reverse) {
+            /* Drop what is still queued the old way, then start back immediately. */
+            if (ptz_issue_motor(ctx, a, ptz_dir_name(dir), 0, 1, cfg->ioctl_stop, true) != 0) return -1;
+            ctx->cont[a].next_due = *now;
+        } else {
+            struct timespec sooner = ptz_timespec_add_us(*now, interval_us);
+            if (ptz_timespec_ge(&ctx->cont[a].next_due, &sooner)) ctx->cont[a].next_due = sooner;
+        }
+    }
+    ctx->cont[a].interval_us = interval_us;
+
+    if (cfg->set_speed_each_move && cfg->ioctl_set_speed && speed != ctx->cont[a].speed) {
+        if (ptz_issue_motor(ctx, a, ptz_dir_name(dir), speed, 1, cfg->ioctl_set_speed, true) != 0) return -1;
+        ctx->cont[a].speed = speed;
+    }
+
+    PTZ_LOGD(cfg, "velocity axis=%s v=%.3f level=%d speed=%d step=%d interval_ms=%ld",
+             ptz_axis_name(a), v, level, speed, drive, interval_us / 1000L);
+    return 0;
+}
+
+int ptz_set_velocity(ptz_ctx_t *ctx, double vx, double vy) {
+    if (!ctx) return -1;
+    if (isnan(vx)) vx = 0.0;
+    if (isnan(vy)) vy = 0.0;
+
+    bool was_active = ctx->cont[PTZ_AXIS_PAN].active || ctx->cont[PTZ_AXIS_TILT].active;
+    if (fabs(vx) < VEL_DEADBAND && fabs(vy) < VEL_DEADBAND) {
+        /* Clients repeat zero velocities while idle; only a running move needs stopping. */
+        return (was_active || ctx->move.active) ? ptz_stop(ctx) : 0;
+    }
+
+    /* Updates to our own running move stay in place; starting (or taking back) motion claims it like any move. */
+    if (!was_active || ptz_motion_superseded(ctx)) {
+        ptz_plan_preempt(ctx);
+        ptz_motion_claim(ctx);
+        ptz_log_line(&ctx->cfg, "velocity start v=%.3f,%.3f", vx, vy);
+    }
+
+    struct timespec now;
+    if (ptz_ctx_now(ctx, &now) != 0) return -1;
+
+    int level[2] = { vel_level(vx), vel_level(vy) };
+    int top = (level[0] > level[1]) ? level[0] : level[1];
+    long interval_us = interval_us_from_cfg(&ctx->cfg) * VEL_LEVELS / top;
+    if (interval_us > 1000000L) interval_us = 1000000L;
+
+    int rc = vel_axis(ctx, PTZ_AXIS_PAN, vx, level[0], interval_us, &now);
+    if (vel_axis(ctx, PTZ_AXIS_TILT, vy, level[1], interval_us, &now) != 0) rc = -1;
+    if (rc != 0) ptz_log_line(&ctx->cfg, "velocity failed v=%.3f,%.3f", vx, vy);
+
+    /* Phase-align: whichever axis is due first sets the tick for both. */
+    if (ctx->cont[PTZ_AXIS_PAN].active && ctx->cont[PTZ_AXIS_TILT].active) {
+        struct timespec *p = &ctx->cont[PTZ_AXIS_PAN].next_due, *t = &ctx->cont[PTZ_AXIS_TILT].next_due;
+        if (ptz_timespec_ge(p, t)) *p = *t;
+        else *t = *p;
+    }
+    return rc;
+}
+
+int ptz_next_deadline(const ptz_ctx_t *ctx, struct timespec *due) {
+    if (!ctx || !due) return -1;
+
+    int found = 0;
+    for (int a = 0; a < 2; a++) {
+        if (!ctx->cont[a].active) continue;
+        if (!found || ptz_timespec_ge(due, &ctx->cont[a].next_due)) *due = ctx->cont[a].next_due;
+        found = 1;
+    }
+    if (ctx->move.active) {
+        if (!found || ptz_timespec_ge(due, &ctx->move.next_due)) *due = ctx->move.next_due;
+        found = 1;
+    } else if (ctx->tour.active) {
+        /* Dwelling at a stop (or a leg that had nothing to move): the tour is next. */
+        if (!found || ptz_timespec_ge(due, &ctx->tour.next_due)) *due = ctx->tour.next_due;
+        found = 1;
+    }
+    return found;
+}
+
+int ptz_next_timeout_ms(const ptz_ctx_t *ctx) {
+    struct timespec due, now;
+    if (ptz_next_deadline(ctx, &due) <= 0) return -1;
+    if (ptz_ctx_now(ctx, &now) != 0) return 5;
+
+    /* Round up: waking before the deadline would only find nothing due and spin. */
+    long long ns = (long long)(due.tv_sec - now.tv_sec) * 1000000000LL + (due.tv_nsec - now.tv_nsec);
+    if (ns <= 0) return 0;
+    return (int)((ns + 999999LL) / 1000000LL);
+}
+
+int ptz_timerfd_arm(const ptz_ctx_t *ctx, int tfd) {
+    if (!ctx || tfd < 0) return -1;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    int rc = ptz_next_deadline(ctx, &its.it_value);
+    if (rc < 0) return -1;
+    /* An all-zero it_value disarms; a deadline at the epoch of the clock still has to fire. */
+    if (rc > 0 && its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) != 0) return -1;
+    return rc;
+}
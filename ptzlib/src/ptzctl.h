@@ -3,18 +3,23 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Where ptzctl looks for a resident ptzd before falling back to in-process control. */
+#define PTZD_SOCKET_DEFAULT "/tmp/ptzd.sock"
+
 /* Public configuration. Keep this stable so other binaries can reuse it. */
 typedef struct ptz_config {
     char anyka_proc[64];
     int anyka_pid; /* optional override; if >0, use this PID instead of scanning by name */
     char state_dir[256];
     char log_file[256];
+    char ptzd_socket[108]; /* AF_UNIX control socket of the resident ptzd daemon */
 
     unsigned long pan_fd_addr;
     unsigned long tilt_fd_addr;
@@ -29,6 +34,7 @@ typedef struct ptz_config {
          0 = auto (prefer /dev/motorX if present, else legacy /proc/PID/fd)
          1 = /dev/motorX only
          2 = legacy /proc/PID/fd only
+         3 = simulated motors (no hardware; see sim_* below)
     */
     char pan_dev[64];
     char tilt_dev[64];
@@ -73,56 +79,463 @@ typedef struct ptz_config {
     int absrel_chunk_steps;
     int absrel_interval_ms;
 
+    /* abs/rel trajectory planner limits (steps/s, steps/s^2). 0 (the default) = legacy fixed-size chunks. */
+    int pan_max_vel;
+    int pan_accel;
+    int tilt_max_vel;
+    int tilt_accel;
+
     int zoom_supported;
     int debug_log;
+    int log_level;    /* 0 = errors, 1 = info, 2 = debug (per-ioctl motor lines) */
+    int log_max_kb;   /* rotate LOG_FILE to LOG_FILE.1 beyond this size; 0 = never */
+    int log_flush_ms; /* max age of a buffered log line; 0 = write every line immediately */
+
+    int position_text_export; /* also mirror the position to STATE_DIR/ptz_position for shell scripts */
+
+    /* MOTOR_BACKEND=3 timing model */
+    int sim_step_rate;        /* steps per second until the first SET_SPEED */
+    int sim_ioctl_latency_us; /* cost of every simulated ioctl */
+
+    /* Binary trace of every motor command, shared by all processes (ptz_trace.c). "" or 0 records = off. */
+    char trace_file[256];
+    int trace_records;
+
+    /* Shared-memory command ring served by ptzd (ptz_cmdq.c). "" or 0 slots = off. */
+    char cmdq_file[256];
+    int cmdq_slots;
 } ptz_config_t;
 
+struct ptz_state_shm;
+struct ptz_trace_shm;
+struct ptz_cmdq_shm;
+
+/* Direction of a manual move (ptz_move()). A diagonal moves tilt and pan from one command; in/out only update the
+   stored zoom. */
+typedef enum {
+    PTZ_DIR_NONE = 0,
+    PTZ_DIR_LEFT,
+    PTZ_DIR_RIGHT,
+    PTZ_DIR_UP,
+    PTZ_DIR_DOWN,
+    PTZ_DIR_UP_LEFT,
+    PTZ_DIR_UP_RIGHT,
+    PTZ_DIR_DOWN_LEFT,
+    PTZ_DIR_DOWN_RIGHT,
+    PTZ_DIR_IN,
+    PTZ_DIR_OUT,
+    PTZ_DIR_COUNT
+} ptz_dir_t;
+
+/* Speed of a manual move when none is given (ONVIF scale, 0..1). */
+#define PTZ_SPEED_DEFAULT 0.5
+
+/* Trapezoidal velocity profile over `dist` (ptz_plan.c). Times in seconds. */
+typedef struct {
+    double dist;
+    double vpeak;
+    double accel;
+    double t_acc;
+    double t_cruise;
+    double total;
+} ptz_profile_t;
+
+/* Time source for a context (ptz_clock.c): a CLOCK_MONOTONIC-like now() and an absolute sleep. */
+typedef struct ptz_clock {
+    int (*now)(void *user, struct timespec *out);
+    void (*sleep_until)(void *user, const struct timespec *deadline);
+    void *user;
+} ptz_clock_t;
+
+/* Virtual time: stands still until something sleeps on it, then jumps to the deadline. */
+typedef struct ptz_vclock {
+    ptz_clock_t clock;
+    struct timespec now;
+} ptz_vclock_t;
+
+#define PTZ_TOUR_MAX 16
+
 typedef struct ptz_ctx {
     ptz_config_t cfg;
 
+    /* NULL: the real monotonic clock. Set with ptz_ctx_set_clock(). */
+    const ptz_clock_t *clock;
+
     /* Runtime state for "continuous" moves.
        Pure library: no fork()/threads. The caller must call ptz_tick() periodically.
        When continuous_mode is enabled, ptz_move_dir() arms a movement and returns.
        The movement runs only while this process keeps calling ptz_tick(). */
     struct {
         bool active;
-        char dir[8];
+        ptz_dir_t dir;
         int step;
         int rep;
         unsigned long fd_addr;
         struct timespec next_due;
+        long interval_us; /* tick period; 0 = WORKER_INTERVAL_MS (ptz_set_velocity() scales it) */
+        int speed;        /* last IOCTL_SET_SPEED sent by ptz_set_velocity(), 0 = none yet */
     } cont[2];
+
+    /* Runtime state for abs/rel/preset moves, driven by ptz_tick() in the same way (ptz_plan.c).
+       steps/done/sign are per axis (ptz_axis order); from/to are pan, tilt (steps) and zoom. */
+    struct {
+        unsigned id;  /* bumped by every move started, so a tour can tell its leg from a newer move */
+        bool active;
+        bool planned; /* trapezoidal profile; false: fixed ABSREL_CHUNK_STEPS pieces */
+        bool failed;  /* the last move was abandoned on a motor error */
+        bool preempted; /* the last move was stopped short: ptz_stop(), a newer move, or another process */
+        ptz_profile_t prof;
+        int steps[2];
+        int done[2];
+        int sign[2];
+        int speed[2]; /* last SET_SPEED sent, -1 = none yet */
+        ptz_dir_t dir[2];
+        int from[3];
+        int to[3];
+        struct timespec t0;
+        struct timespec next_due;
+        bool settling;          /* everything issued; waiting for GET_STATE to report idle */
+        struct timespec settle_by; /* stop waiting for idle: after the last command, or after a legacy piece */
+        long poll_us;           /* current GET_STATE backoff */
+    } move;
+
+    /* Preset tour, driven by ptz_tick() after the abs/rel move it starts for each leg (ptz_tour.c).
+       stop[] is in tour order; stop[i] also holds the leg into it from stop[i - 1] (wrapping), planned once
+       by ptz_tour_start(). */
+    struct {
+        bool active;
+        bool dwelling;
+        int n;
+        int cur;            /* stop being approached or dwelt at */
+        int retries;        /* leg restarts after being cut short, per stop */
+        unsigned move_id;   /* ctx->move.id of our leg */
+        long cycles;
+        long cycle_ms;      /* planned: legs plus dwells */
+        struct timespec next_due;
+        struct ptz_tour_stop {
+            int preset;
+            int dwell_ms;
+            int pan_deg;    /* the preset, as stored */
+            int tilt_deg;
+            int to[3];      /* pan, tilt (steps), zoom */
+            int delta[2];   /* the leg, in logical steps */
+            bool planned;   /* prof is valid; false: fixed chunks */
+            ptz_profile_t prof;
+            long travel_ms;
+        } stop[PTZ_TOUR_MAX];
+    } tour;
+
+    /* Per-axis calibration, precomputed by ptz_ctx_init(). Position is tracked in motor steps;
+       degrees and normalized coordinates are derived from it only at the API. */
+    struct {
+        int total_steps;
+        int max_deg;
+        bool invert;
+        uint32_t steps_per_deg_q16; /* 16.16 fixed point */
+        uint32_t deg_per_step_q16;
+    } kin[2];
+
+    /* Per single-axis direction (PTZ_DIR_LEFT..PTZ_DIR_DOWN), precomputed from the STEP_* keys and *_INVERT by
+       ptz_ctx_init() and on reload, so a move does no string or config lookups. */
+    struct {
+        int mult;     /* >= 1 */
+        int rep;      /* >= 1 */
+        int polarity; /* driver sign of a step this way */
+        int abs_max;  /* tighter of the *_STEP_ABS_MAX clamps, 0 = none */
+    } dirs[PTZ_DIR_DOWN + 1];
+
+    /* Motor device handles, opened on first use and kept for the context lifetime (fd < 0: not open). */
+    struct {
+        int fd;
+        bool borrowed; /* obtained through the legacy /proc backend */
+        bool no_state; /* driver rejected IOCTL_GET_STATE; pace by time instead */
+        char via[128];
+    } motor[2];
+
+    /* Legacy /proc backend: identity of the process whose motor FDs are borrowed.
+       Re-resolved only when that process restarts (start time changes or its pidfd fires). */
+    struct {
+        int pid;
+        unsigned long long start_time;
+        int pidfd;
+    } proc;
+
+    /* MOTOR_BACKEND=3: simulated axes, in steps. Moving from `from` (at t0) towards `target`. */
+    struct {
+        int from;
+        int target;
+        int speed_step; /* 0: SIM_STEP_RATE */
+        struct timespec t0;
+    } sim[2];
+
+    /* STATE_DIR/ptz_state.bin, mapped shared by ptz_ctx_init(). NULL falls back to the text file. */
+    struct ptz_state_shm *state;
+    uint32_t motion_gen; /* our claim on state->motion_gen; see ptz_motion_claim() */
+
+    /* TRACE_FILE, mapped shared by ptz_ctx_init(). NULL: not tracing. */
+    struct ptz_trace_shm *trace;
+    size_t trace_bytes;
+
+    /* Consumer side of CMDQ_FILE (ptz_cmdq_serve()). ring NULL: not serving. */
+    struct {
+        struct ptz_cmdq_shm *ring;
+        size_t bytes;
+        int efd;                   /* eventfd doorbell, handed to producers by ptzd */
+        uint32_t full_seen;        /* ring->full last logged */
+        uint32_t stuck_pos;        /* a slot claimed but not published... */
+        struct timespec stuck_since; /* ...since then (CLOCK_MONOTONIC) */
+    } cmdq;
+
+    /* Config hot reload (ptz_reload.c): inotify watch on the config file's directory. fd < 0: not watching. */
+    struct {
+        int fd;
+        char path[256];
+        char name[128]; /* basename of path, matched against the directory's events */
+    } reload;
 } ptz_ctx_t;
 
 /* Defaults + config loading */
 void ptz_config_init_defaults(ptz_config_t *cfg);
 /* Load KEY=VALUE overrides (same keys as the old file). Returns 0 on success, -1 on open/read error. */
 int ptz_config_load_file(ptz_config_t *cfg, const char *path);
+/* 0 if the library can run with `cfg`; otherwise -1 and a short reason in `why`. */
+int ptz_config_validate(const ptz_config_t *cfg, char *why, size_t why_sz);
 
 /* Context */
 int ptz_ctx_init(ptz_ctx_t *ctx, const ptz_config_t *cfg);
+/* Release what the context holds open (motor FDs, pidfd, state mapping). Safe to call more than once. */
+void ptz_ctx_close(ptz_ctx_t *ctx);
+
+/* Run the context on another clock, e.g. &vclock.clock for a fast-forward simulation on MOTOR_BACKEND=3.
+   Call it right after ptz_ctx_init(), before any motion; `clock` must outlive the context. NULL restores the real
+   clock. ptz_timerfd_arm() only makes sense on the real clock. */
+void ptz_ctx_set_clock(ptz_ctx_t *ctx, const ptz_clock_t *clock);
+/* The context's clock, for event loops that should run on either kind. */
+int ptz_ctx_now(const ptz_ctx_t *ctx, struct timespec *out);
+void ptz_ctx_sleep_until(const ptz_ctx_t *ctx, const struct timespec *deadline);
+
+/* Start a virtual clock at `start` (NULL: 1000 s). */
+void ptz_vclock_init(ptz_vclock_t *vc, const struct timespec *start);
+void ptz_vclock_advance_us(ptz_vclock_t *vc, long us);
+
+/* Swap in a new config between ticks. It is validated first (-1 and nothing changes if it fails).
+   Only what depends on changed keys is redone: kinematics, motor FDs (reopened lazily), the state mapping.
+   An armed continuous move keeps running (WORKER_INTERVAL_MS applies from its next tick) unless the step it
+   was armed with changed: the STEP_ and CONTINUOUS_ tuning, an _INVERT flag or the calibration stop it.
+   An abs/rel/preset move is stopped if the calibration it was planned with changed. PTZD_SOCKET is kept
+   (needs a restart). */
+int ptz_ctx_reconfigure(ptz_ctx_t *ctx, const ptz_config_t *cfg);
+
+/* Watch `path` for changes (inotify). Returns an fd to poll for POLLIN, or -1. */
+int ptz_config_watch(ptz_ctx_t *ctx, const char *path);
+/* When the watch fd is readable: drain it and, if the file changed, load it over the defaults and apply it
+   through ptz_ctx_reconfigure(). Returns 1 if a new config was applied, 0 if nothing changed, -1 if rejected. */
+int ptz_config_reload(ptz_ctx_t *ctx);
+
+/* Write out buffered log lines now (also done by ptz_ctx_close() and at exit). */
+void ptz_log_flush(void);
+
+/* This process's instrumentation in the Prometheus text format: ioctl latency histograms per axis and command,
+   ioctl errors, tick lateness, skipped catch-ups, motor open failures and log volume.
+   Returns the length, or -1 if it did not fit in `out`. */
+int ptz_stats_format(char *out, size_t out_sz);
+void ptz_stats_reset(void);
 
 /* Position state */
 int ptz_get_position(const ptz_ctx_t *ctx, int *pan_deg, int *tilt_deg, int *zoom);
 int ptz_set_position(const ptz_ctx_t *ctx, int pan_deg, int tilt_deg, int zoom);
 
-/* Movements */
+/* Movements. `speed` is the ONVIF factor 0..1 (sign ignored); it scales the driver speed and how far each command
+   goes. A diagonal arms both axes with one shared tick in continuous mode, so every ptz_tick() issues both.
+   -1 for PTZ_DIR_NONE. */
+int ptz_move(ptz_ctx_t *ctx, ptz_dir_t dir, double speed);
+/* "left", "right", "up", "down", "in", "out", or a diagonal such as "up-left" (tilt and pan, either order).
+   PTZ_DIR_NONE if it is none of these. */
+ptz_dir_t ptz_dir_parse(const char *s);
+const char *ptz_dir_name(ptz_dir_t dir);
+/* The string form of ptz_move(): `speed` NULL or "" is PTZ_SPEED_DEFAULT. */
 int ptz_move_dir(ptz_ctx_t *ctx, const char *dir, const char *speed);
+/* pan/tilt are -1, 0 or 1 (right and up positive); (0,0) is ptz_stop(). */
+int ptz_move_vector(ptz_ctx_t *ctx, int pan, int tilt, const char *speed);
 int ptz_stop(ptz_ctx_t *ctx);
 int ptz_home(ptz_ctx_t *ctx);
 
-/* Normalized coordinates in [-1,1] (as used by -j/-J in the original CLI). */
+/* Velocity-mode continuous move (ONVIF ContinuousMove): vx > 0 pans right, vy > 0 tilts up, both in [-1,1].
+   Meant to be called for every velocity a client streams: an armed axis is updated in place, IOCTL_SET_SPEED is
+   only sent when the speed (quantized to 1/32 of *_SPEED_STEP) changes, and slower axes tick less often.
+   Runs on ptz_tick() whatever CONTINUOUS_MODE says; (0,0) stops a running move like ptz_stop(). */
+int ptz_set_velocity(ptz_ctx_t *ctx, double vx, double vy);
+
+/* 1 while a move is running: an armed continuous or abs/rel/preset move, or either motor reporting RUNNING
+   through IOCTL_GET_STATE (so another process's move counts too). 0 when idle. */
+int ptz_is_moving(ptz_ctx_t *ctx);
+/* Keep ticking until ptz_is_moving() is 0. Returns 0 when idle, 1 on timeout (timeout_ms < 0: no limit), -1 on error. */
+int ptz_wait_idle(ptz_ctx_t *ctx, int timeout_ms);
+
+/* Normalized coordinates in [-1,1] (as used by -j/-J in the original CLI).
+   The _start variants set the move up and return; ptz_tick() drives it, and a new move or ptz_stop()
+   preempts it. The plain variants start the move and wait for it (ptz_move_wait()). */
+int ptz_move_abs_start(ptz_ctx_t *ctx, double x, double y, double z);
+int ptz_move_rel_start(ptz_ctx_t *ctx, double dx, double dy, double dz);
 int ptz_move_abs(ptz_ctx_t *ctx, double x, double y, double z);
 int ptz_move_rel(ptz_ctx_t *ctx, double dx, double dy, double dz);
 
-/* Presets */
+typedef struct ptz_move_status {
+    bool active;
+    bool failed;     /* the last move was abandoned on a motor error */
+    bool preempted;  /* the last move was stopped before it arrived */
+    double progress; /* 0..1 of the steps issued; 1 when idle */
+    long eta_ms;     /* time left until arrival (estimate) */
+    int target_pan;  /* degrees */
+    int target_tilt;
+    int target_zoom;
+} ptz_move_status_t;
+
+/* Progress of the current abs/rel/preset move. Returns 1 while one is running, 0 when idle, -1 on error. */
+int ptz_move_status(const ptz_ctx_t *ctx, ptz_move_status_t *st);
+/* Call ptz_tick() until the current move is done. Returns 0 when it arrived, 1 if it failed, 2 if it was
+   preempted before arriving (ptz_stop(), a newer move, or another process taking the motors over). The
+   blocking abs/rel/preset calls return the same codes. */
+int ptz_move_wait(ptz_ctx_t *ctx);
+
+/* Presets (ids 1..PTZ_PRESET_MAX, stored in STATE_DIR/ptz_presets.idx + .jnl) */
+#define PTZ_PRESET_MAX      64
+#define PTZ_PRESET_NAME_MAX 40
+
+typedef struct ptz_preset {
+    int id;
+    char name[PTZ_PRESET_NAME_MAX];
+    int pan_deg;
+    int tilt_deg;
+    int zoom;
+} ptz_preset_t;
+
+/* Same as ptz_preset_goto() with the id given as a string (CLI/ONVIF form). */
 int ptz_move_preset(ptz_ctx_t *ctx, const char *preset_id);
+/* Store the current position as preset `id` (id <= 0 picks the next id). Returns the id, or -1. */
+int ptz_preset_save(ptz_ctx_t *ctx, int id, const char *name);
+/* Returns 0, or -1 for an invalid id or a failed write. */
+int ptz_preset_delete(ptz_ctx_t *ctx, int id);
+/* Copy up to `max` presets in id order. Returns how many exist, or -1. */
+int ptz_preset_list(ptz_ctx_t *ctx, ptz_preset_t *out, int max);
+/* Render the list as "id,name,pan,tilt,zoom" lines (the format of the old ptz_presets.db). Returns 0, or -1
+   (also when the list does not fit in `out_sz`). */
+int ptz_format_presets(ptz_ctx_t *ctx, char *out, size_t out_sz);
+/* Drive both axes to the stored position through the absolute-move path. Returns 1 if the id is unknown. */
+int ptz_preset_goto_start(ptz_ctx_t *ctx, int id);
+int ptz_preset_goto(ptz_ctx_t *ctx, int id);
+
+/* Preset tour (patrol): visit presets in a loop on ptz_tick(), dwelling at each, without blocking the caller.
+   Every leg's trajectory is planned once, when the tour starts. With `optimize` the stops are reordered for the
+   shortest cycle under the pan/tilt travel-time model and the tour starts at the stop nearest the head;
+   otherwise it starts with spots[0] and keeps the given order. Runs until ptz_tour_stop(), ptz_stop() or any
+   other motion command. Returns 0, 1 if a preset does not exist, -1 on bad arguments. */
+typedef struct ptz_tour_spot {
+    int preset;
+    int dwell_ms;
+} ptz_tour_spot_t;
+
+typedef struct ptz_tour_status {
+    bool active;
+    bool dwelling;           /* at `preset`; false: on the way to it */
+    int preset;
+    int n;
+    int order[PTZ_TOUR_MAX]; /* preset ids in tour order */
+    long cycles;             /* completed */
+    long cycle_ms;           /* planned cycle time: travel plus dwells */
+} ptz_tour_status_t;
+
+int ptz_tour_start(ptz_ctx_t *ctx, const ptz_tour_spot_t *spots, int n, bool optimize);
+/* End the tour; a leg in flight stops where it is. */
+void ptz_tour_stop(ptz_ctx_t *ctx);
+/* Returns 1 while a tour runs, 0 when none does (the last tour's order and cycle time are still reported), -1 on error. */
+int ptz_tour_status(const ptz_ctx_t *ctx, ptz_tour_status_t *st);
+/* Parse "id[:dwell_s],..." (e.g. "1:10,4:7.5,2"; dwell defaults to 5 s). Returns the number of spots, or -1. */
+int ptz_tour_parse(const char *list, ptz_tour_spot_t *out, int max);
+
+/* Motion ownership across processes sharing STATE_DIR: every motion command (move, stop, home, abs/rel/preset)
+   takes it over, and a context that has been superseded drops its armed moves on its next ptz_tick().
+   True once another process has issued a motion command after this context's last one; such a context
+   should not send a parting ptz_stop(), which would cut off the new owner. */
+bool ptz_motion_superseded(const ptz_ctx_t *ctx);
 
 /* Event-loop hook.
-   Call this periodically (e.g. every 5-20ms) to execute any armed continuous movement.
+   Call this periodically (e.g. every 5-20ms) to execute any armed continuous movement and to advance
+   a started abs/rel/preset move.
    Returns 1 if it issued at least one motor command, 0 if nothing was due, -1 on error. */
 int ptz_tick(ptz_ctx_t *ctx);
 
+/* When ptz_tick() next has work (CLOCK_MONOTONIC). Returns 1 and fills `due`, or 0 when nothing is armed:
+   an idle caller need not wake up at all until it starts another move. */
+int ptz_next_deadline(const ptz_ctx_t *ctx, struct timespec *due);
+/* The same as a poll()/epoll timeout: milliseconds (rounded up), 0 if already due, -1 when idle. */
+int ptz_next_timeout_ms(const ptz_ctx_t *ctx);
+/* Arm a timerfd (timerfd_create(CLOCK_MONOTONIC, ...)) to fire at the next deadline, or disarm it when idle.
+   Call after every ptz_tick() and after starting a move; read the fd when it fires. Returns as ptz_next_deadline(). */
+int ptz_timerfd_arm(const ptz_ctx_t *ctx, int tfd);
+
+/* Shared-memory command ring (CMDQ_FILE) for processes on the same device that steer the motors often (an ONVIF
+   server, a tracker): a push is a few stores into a mapped ring plus one eventfd write, instead of a socket round
+   trip or a ptzctl process. Any number of producers, one consumer: the process that owns the ptz_ctx_t (ptzd).
+   Commands are applied in order; of several velocity updates that arrive together only the latest is applied. */
+typedef enum {
+    PTZ_CMD_STOP = 1,
+    PTZ_CMD_HOME,
+    PTZ_CMD_VELOCITY, /* v = vx, vy */
+    PTZ_CMD_MOVE,     /* arg = ptz_dir_t, v = speed (0: PTZ_SPEED_DEFAULT); as ptz_move() */
+    PTZ_CMD_ABS,      /* v = x, y, z */
+    PTZ_CMD_REL,      /* v = dx, dy, dz */
+    PTZ_CMD_PRESET,   /* arg = preset id */
+} ptz_cmd_op_t;
+
+typedef struct ptz_cmd {
+    ptz_cmd_op_t op;
+    int arg;
+    double v[3];
+} ptz_cmd_t;
+
+/* Producer handle. */
+typedef struct ptz_cmdq {
+    struct ptz_cmdq_shm *ring;
+    size_t bytes;
+    int doorbell;          /* the consumer's eventfd, -1 until fetched */
+    uint32_t consumer_gen; /* ring->consumer_gen the doorbell belongs to */
+    char socket[108];      /* where to fetch it: PTZD_SOCKET */
+} ptz_cmdq_t;
+
+/* Map the ring the consumer created and fetch its doorbell from ptzd. -1 if there is no ring (ptzd not running
+   with CMDQ_SLOTS > 0). */
+int ptz_cmdq_open(ptz_cmdq_t *q, const ptz_config_t *cfg);
+void ptz_cmdq_close(ptz_cmdq_t *q);
+/* Enqueue one command and ring the doorbell. Lock-free and safe from any number of processes and threads.
+   Returns 0, or -1 with errno EAGAIN when the ring is full. */
+int ptz_cmdq_push(ptz_cmdq_t *q, const ptz_cmd_t *cmd);
+
+/* Consumer: create or take over CMDQ_FILE and its doorbell. Commands left over from a previous consumer are
+   discarded, not applied late. Returns the eventfd to poll for POLLIN, or -1 (also when CMDQ_SLOTS is 0). */
+int ptz_cmdq_serve(ptz_ctx_t *ctx);
+/* When the eventfd is readable: apply everything published so far. Returns the number of commands applied. */
+int ptz_cmdq_drain(ptz_ctx_t *ctx);
+
+/* Daemon control protocol (ptzd).
+   One request line per connection: "move <dir> <speed>", "stop", "home", "abs x,y,z", "rel dx,dy,dz",
+   "preset <id>", "preset-save <name>", "preset-del <id>", "preset-list", "get-position", "is-moving",
+   "move-status", "velocity vx,vy", "stats", "tour <id[:dwell_s],...> [keep]", "tour-stop", "tour-status".
+   The reply is "<rc>\n" followed by an optional payload.
+   abs/rel/preset/tour are answered as soon as the move has started; "move-status" replies "<active> <progress> <eta_ms>";
+   "tour-status" replies "<active> <preset> <cycles> <cycle_ms> <id,id,...>" ("keep" starts the tour in the given order);
+   "stats" replies with the daemon's ptz_stats_format(); "cmdq-doorbell" replies "0" with the command ring's eventfd
+   attached (SCM_RIGHTS). A reply is at most PTZ_IPC_REPLY_MAX bytes. */
+#define PTZ_IPC_REPLY_MAX 32768
+int ptz_ipc_listen(const char *path);
+/* Accept and answer one pending connection. Returns 1 if served, 0 if nothing was pending, -1 on error. */
+int ptz_ipc_serve_one(ptz_ctx_t *ctx, int listen_fd);
+int ptz_ipc_handle(ptz_ctx_t *ctx, const char *req, char *reply, size_t reply_sz);
+/* Client side. Returns 0 when a reply was received, -1 if the daemon is unreachable. */
+int ptz_ipc_request(const char *path, const char *req, char *reply, size_t reply_sz);
+/* Split a reply in place into its rc and payload. */
+int ptz_ipc_parse_reply(char *reply, const char **payload);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptzctl.h"
+#include "ptz_util.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/* ptzd: resident owner of one ptz_ctx_t.
+   Loads ptz.conf and opens the motors once, then serves ptzctl (and anything else speaking the
+   line protocol from ptzctl.h) over an AF_UNIX socket while driving ptz_tick() itself.
+   Edits to ptz.conf are applied between ticks (ptz_config_reload()); PTZD_SOCKET needs a restart.
+   With CMDQ_SLOTS > 0 it also applies commands pushed onto the shared-memory ring (ptz_cmdq_push()). */
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_stop(int sig) { (void)sig; g_stop = 1; }
+
+int main(int argc, char *argv[]) {
+    ptz_config_t cfg;
+    ptz_config_init_defaults(&cfg);
+
+    const char *conf_path = "/tmp/sd/custom/configs/ptz.conf";
+    const char *sock_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) conf_path = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) sock_path = argv[++i];
+    }
+
+    (void)ptz_config_load_file(&cfg, conf_path);
+    if (sock_path) snprintf(cfg.ptzd_socket, sizeof(cfg.ptzd_socket), "%s", sock_path);
+
+    ptz_ctx_t ctx;
+    if (ptz_ctx_init(&ctx, &cfg) != 0) return 1;
+
+    int lfd = ptz_ipc_listen(cfg.ptzd_socket);
+    if (lfd < 0) {
+        fprintf(stderr, "ptzd: cannot listen on %s: %s\n", cfg.ptzd_socket, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, on_stop);
+    signal(SIGTERM, on_stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Sleep exactly until the next due command; without a timerfd fall back to a poll() timeout. */
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int wfd = ptz_config_watch(&ctx, conf_path);
+    if (wfd < 0) fprintf(stderr, "ptzd: not watching %s: %s\n", conf_path, strerror(errno));
+    int qfd = ptz_cmdq_serve(&ctx);
+
+    while (!g_stop) {
+        int timeout_ms = -1;
+        int armed = (tfd >= 0) ? ptz_timerfd_arm(&ctx, tfd) : -1;
+        if (armed < 0) timeout_ms = ptz_next_timeout_ms(&ctx);
+        if (armed == 0 || (armed < 0 && timeout_ms < 0))
+            ptz_log_flush(); /* going idle: don't leave lines buffered indefinitely */
+
+        /* poll() skips entries with fd < 0, so a missing timerfd or watch needs no special casing. */
+        struct pollfd pfd[4] = {
+            { .fd = lfd, .events = POLLIN, .revents = 0 },
+            { .fd = tfd, .events = POLLIN, .revents = 0 },
+            { .fd = wfd, .events = POLLIN, .revents = 0 },
+            { .fd = qfd, .events = POLLIN, .revents = 0 },
+        };
+        int pr = poll(pfd, 4, timeout_ms);
+        if (pr < 0 && errno != EINTR) break;
+
+        if (pr > 0 && (pfd[1].revents & POLLIN)) {
+            uint64_t expirations;
+            ssize_t n = read(tfd, &expirations, sizeof(expirations));
+            (void)n; /* only drains the fd; ptz_tick() below works out what is due */
+        }
+        if (pr > 0 && (pfd[2].revents & POLLIN)) (void)ptz_config_reload(&ctx);
+        if (pr > 0 && (pfd[0].revents & POLLIN)) (void)ptz_ipc_serve_one(&ctx, lfd);
+        if (pr > 0 && (pfd[3].revents & POLLIN)) (void)ptz_cmdq_drain(&ctx);
+
+        /* A failing motor would otherwise be retried every interval forever. */
+        if (ptz_tick(&ctx) < 0) (void)ptz_stop(&ctx);
+    }
+
+    if (!ptz_motion_superseded(&ctx)) (void)ptz_stop(&ctx);
+    ptz_ctx_close(&ctx);
+    if (tfd >= 0) close(tfd);
+    close(lfd);
+    (void)unlink(cfg.ptzd_socket);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ptz_internal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ptztrace: read the motor command trace (TRACE_FILE, see ptz_trace.c).
+
+   ptztrace [-c ptz.conf] [-f trace.bin] [-n last] dump [-o snapshot.bin]
+   ptztrace [-c ptz.conf] [-f trace.bin] [-n last] replay [-x factor] [--hw | --virtual] [-v]
+
+   dump prints one line per command; with -o it saves the records instead, so the trace survives a reboot and
+   can be replayed elsewhere (-f snapshot.bin). replay re-issues the commands with their original spacing divided
+   by -x (0: back to back) through ptz_issue_motor(), on the simulated motors unless --hw is given, and reports
+   how the latencies and return codes compare with the recording. --virtual runs the simulation on a virtual clock:
+   no waiting, and the same result every time. */
+
+static int cmp_time(const void *a, const void *b) {
+    const ptz_trace_entry_t *x = a, *y = b;
+    return (x->t_ns > y->t_ns) - (x->t_ns < y->t_ns);
+}
+
+static const char *cmd_name(const ptz_config_t *cfg, unsigned long cmd, char *buf, size_t sz) {
+    ptz_stat_cmd_t c = ptz_stats_cmd(cfg, cmd);
+    if (c != PTZ_STAT_OTHER) return ptz_stats_cmd_name(c);
+    snprintf(buf, sz, "0x%lx", cmd);
+    return buf;
+}
+
+static int dump(const ptz_config_t *cfg, const ptz_trace_entry_t *e, int n, const char *out_path) {
+    if (out_path) {
+        if (ptz_trace_save(out_path, e, n) != 0) {
+            fprintf(stderr, "ptztrace: %s: %s\n", out_path, strerror(errno));
+            return 1;
+        }
+        printf("saved %d records to %s\n", n, out_path);
+        return 0;
+    }
+
+    printf("# t_ms pid axis cmd step rep rc errno lat_us\n");
+    for (int i = 0; i < n; i++) {
+        char buf[24];
+        printf("%.3f %d %s %s %d %d %d %d %u\n", (double)(e[i].t_ns - e[0].t_ns) / 1e6, e[i].pid,
+               ptz_axis_name(e[i].axis), cmd_name(cfg, e[i].cmd, buf, sizeof(buf)), e[i].step, e[i].rep,
+               e[i].rc, e[i].err, e[i].lat_us);
+    }
+    return 0;
+}
+
+static long long elapsed_us(const struct timespec *a, const struct timespec *b) {
+    return ((long long)(b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec)) / 1000;
+}
+
+static int replay(ptz_config_t *cfg, const ptz_trace_entry_t *e, int n, double factor, bool hw, bool virt,
+                  bool verbose) {
+    /* Don't record the replay into the ring being replayed. */
+    cfg->trace_records = 0;
+    if (!hw) cfg->motor_backend = PTZ_MOTOR_BACKEND_SIM;
+
+    ptz_ctx_t ctx;
+    if (ptz_ctx_init(&ctx, cfg) != 0) return 1;
+    ptz_vclock_t vc;
+    if (virt && !hw) {
+        ptz_vclock_init(&vc, NULL);
+        ptz_ctx_set_clock(&ctx, &vc.clock);
+    }
+
+    long long lat_sum[2] = { 0, 0 }, lat_max[2] = { 0, 0 }, late_sum = 0, late_max = 0;
+    int mismatches = 0;
+
+    struct timespec start, due, t0, t1;
+    (void)ptz_ctx_now(&ctx, &start);
+    for (int i = 0; i < n; i++) {
+        if (factor > 0) {
+            due = ptz_timespec_add_us(start, (long)((double)(e[i].t_ns - e[0].t_ns) / 1e3 / factor));
+            ptz_ctx_sleep_until(&ctx, &due);
+        }
+        (void)ptz_ctx_now(&ctx, &t0);
+        int rc = ptz_issue_motor(&ctx, e[i].axis, "", e[i].step, e[i].rep, e[i].cmd, false);
+        (void)ptz_ctx_now(&ctx, &t1);
+
+        long long lat = elapsed_us(&t0, &t1), late = (factor > 0) ? elapsed_us(&due, &t0) : 0;
+        lat_sum[0] += e[i].lat_us;
+        lat_sum[1] += lat;
+        if (e[i].lat_us > lat_max[0]) lat_max[0] = e[i].lat_us;
+        if (lat > lat_max[1]) lat_max[1] = lat;
+        late_sum += late;
+        if (late > late_max) late_max = late;
+        if ((rc != 0) != (e[i].rc != 0)) mismatches++;
+
+        if (verbose) {
+            char buf[24];
+            printf("%.3f %s %s %d %d rc=%d/%d lat_us=%u/%lld late_us=%lld\n", (double)(e[i].t_ns - e[0].t_ns) / 1e6,
+                   ptz_axis_name(e[i].axis), cmd_name(cfg, e[i].cmd, buf, sizeof(buf)), e[i].step, e[i].rep,
+                   e[i].rc, rc, e[i].lat_us, lat, late);
+        }
+    }
+    (void)ptz_ctx_now(&ctx, &t1);
+
+    const char *on = hw ? "the configured motors" : ctx.clock ? "simulated motors, virtual time" : "simulated motors";
+    printf("replayed %d commands in %.1f ms on %s (trace span %.1f ms, x%g)\n", n, (double)elapsed_us(&start, &t1) / 1e3,
+           on, (double)(e[n - 1].t_ns - e[0].t_ns) / 1e6, factor);
+    printf("latency_us trace mean=%.0f max=%lld  replay mean=%.0f max=%lld\n", (double)lat_sum[0] / n, lat_max[0],
+           (double)lat_sum[1] / n, lat_max[1]);
+    if (factor > 0) printf("late_us mean=%.0f max=%lld\n", (double)late_sum / n, late_max);
+    printf("rc_mismatches=%d\n", mismatches);
+
+    /* Where the commands left the head once the motors have run out of steps (driver steps). */
+    struct ptz_motor_msg msg[2];
+    bool have = true;
+    for (int a = 0; a < 2; a++) {
+        (void)ptz_motor_wait_idle(&ctx, (ptz_axis_t)a, 10000);
+        if (ptz_motor_get_state(&ctx, (ptz_axis_t)a, &msg[a]) != 0) have = false;
+    }
+    if (have) printf("end pan=%d tilt=%d\n", msg[PTZ_AXIS_PAN].pos, msg[PTZ_AXIS_TILT].pos);
+
+    ptz_ctx_close(&ctx);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *conf_path = "/tmp/sd/custom/configs/ptz.conf";
+    const char *trace_path = NULL;
+    const char *out_path = NULL;
+    const char *mode = "dump";
+    int last = 0;
+    double factor = 1.0;
+    bool hw = false, virt = false, verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) conf_path = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) last = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) factor = atof(argv[++i]);
+        else if (strcmp(argv[i], "--hw") == 0) hw = true;
+        else if (strcmp(argv[i], "--virtual") == 0) virt = true;
+        else if (strcmp(argv[i], "-v") == 0) verbose = true;
+        else if (strcmp(argv[i], "dump") == 0 || strcmp(argv[i], "replay") == 0) mode = argv[i];
+        else {
+            fprintf(stderr, "usage: ptztrace [-c ptz.conf] [-f trace.bin] [-n last] dump [-o snapshot.bin]\n"
+                            "       ptztrace [-c ptz.conf] [-f trace.bin] [-n last] replay [-x factor] [--hw | --virtual] [-v]\n");
+            return 2;
+        }
+    }
+
+    ptz_config_t cfg;
+    ptz_config_init_defaults(&cfg);
+    (void)ptz_config_load_file(&cfg, conf_path);
+    if (!trace_path) trace_path = cfg.trace_file;
+    if (!*trace_path) {
+        fprintf(stderr, "ptztrace: TRACE_FILE is not set (tracing is off); name the ring with -f\n");
+        return 1;
+    }
+
+    ptz_trace_entry_t *e = NULL;
+    int n = ptz_trace_load(trace_path, &e);
+    if (n < 0) {
+        fprintf(stderr, "ptztrace: %s: %s\n", trace_path, strerror(errno));
+        return 1;
+    }
+    if (!n) {
+        fprintf(stderr, "ptztrace: %s: no records\n", trace_path);
+        return 1;
+    }
+
+    /* Records are in completion order; replay wants issue order. */
+    qsort(e, (size_t)n, sizeof(*e), cmp_time);
+    const ptz_trace_entry_t *from = e;
+    if (last > 0 && last < n) {
+        from = e + (n - last);
+        n = last;
+    }
+
+    int rc = (strcmp(mode, "replay") == 0) ? replay(&cfg, from, n, factor, hw, virt, verbose)
+                                           : dump(&cfg, from, n, out_path);
+    free(e);
+    return rc;
+}
@@ -0,0 +1,88 @@
+/* Build-host tool: emit src/ptz_config_hash.h, a perfect hash over the ptz.conf keys.
+
+   Searches for the smallest power-of-two table and a seed for ptz_cfg_key_hash() that put every key
+   in its own slot, so ptz_config.c resolves a key with one hash and one strcmp. Output is deterministic
+   (the first seed that works), so regenerating an unchanged key list gives the same file.
+
+   Usage: gen_config_hash > src/ptz_config_hash.h */
+#include "ptz_config_keys.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_BITS  10
+#define MAX_SEEDS (1u << 24)
+
+static const char *const KEYS[] = {
+#define KEY(k, field, def) k,
+    PTZ_CFG_KEYS(KEY)
+#undef KEY
+};
+static const char KEY_TYPES[] = {
+#define TYPE_S(k, field, def) 'S',
+#define TYPE_H(k, field, def) 'H',
+#define TYPE_I(k, field, def) 'I',
+    CFG_STR(TYPE_S) CFG_HEX(TYPE_H) CFG_INT(TYPE_I)
+#undef TYPE_S
+#undef TYPE_H
+#undef TYPE_I
+};
+
+#define NKEYS (sizeof(KEYS) / sizeof(KEYS[0]))
+
+/* Fingerprint of the key table (names, types, order); the config cache is invalidated when it changes. */
+static uint32_t keys_signature(void) {
+    uint32_t sig = 0;
+    for (size_t i = 0; i < NKEYS; i++) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%c:%s", KEY_TYPES[i], KEYS[i]);
+        sig = ptz_cfg_key_hash(buf, sig);
+    }
+    return sig;
+}
+
+static int try_seed(uint32_t seed, unsigned bits, uint8_t *slot) {
+    uint32_t mask = (1u << bits) - 1;
+    memset(slot, 0, (size_t)1 << bits);
+    for (size_t i = 0; i < NKEYS; i++) {
+        uint32_t s = ptz_cfg_key_hash(KEYS[i], seed) & mask;
+        if (slot[s]) return -1;
+        slot[s] = (uint8_t)(i + 1);
+    }
+    return 0;
+}
+
+int main(void) {
+    static uint8_t slot[1u << MAX_BITS];
+    if (NKEYS >= 255) {
+        fprintf(stderr, "gen_config_hash: %zu keys do not fit the uint8_t slot table\n", NKEYS);
+        return 1;
+    }
+
+    /* Below ~2x the key count a collision-free seed is too rare to be worth the search. */
+    unsigned bits = 1;
+    while ((1u << bits) < 2 * NKEYS) bits++;
+
+    for (; bits <= MAX_BITS; bits++) {
+        for (uint32_t seed = 0; seed < MAX_SEEDS; seed++) {
+            if (try_seed(seed, bits, slot) != 0) continue;
+
+            printf("/* Generated by tools/gen_config_hash.c from ptz_config_keys.h. Do not edit. */\n");
+            printf("#ifndef PTZ_CONFIG_HASH_H\n#define PTZ_CONFIG_HASH_H\n\n");
+            printf("#include <stdint.h>\n\n");
+            printf("#define PTZ_CFG_NKEYS     %zu\n", NKEYS);
+            printf("#define PTZ_CFG_KEYS_SIG  0x%08xu\n", keys_signature());
+            printf("#define PTZ_CFG_HASH_SEED 0x%08xu\n", seed);
+            printf("#define PTZ_CFG_HASH_BITS %u\n\n", bits);
+            printf("/* slot -> key table index + 1; 0 = no key */\n");
+            printf("static const uint8_t PTZ_CFG_HASH_SLOT[1u << PTZ_CFG_HASH_BITS] = {");
+            for (unsigned i = 0; i < (1u << bits); i++)
+                printf("%s%3u,", (i % 16) ? " " : "\n    ", slot[i]);
+            printf("\n};\n\n#endif /* PTZ_CONFIG_HASH_H */\n");
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "gen_config_hash: no perfect hash within 2^%d slots\n", MAX_BITS);
+    return 1;
+}
@@ -18,6 +18,7 @@ load_cfg() {
     ONVIF=1
     ONVIF_PTZ=1
     ONVIF_PTZCTL="${CUSTOM_DIR}/bin/ptzctl"
+    ONVIF_PTZD="${CUSTOM_DIR}/bin/ptzd"
 
     if [ -f "${CFG_FILE}" ]; then
         # shellcheck disable=SC1090
@@ -44,8 +45,22 @@ mount_onvif_ptz_helpers() {
     fi
 }
 
+# Resident PTZ daemon: ptzctl forwards to it over a socket instead of re-initializing per command.
+ensure_ptzd() {
+    if [ "${ONVIF_PTZ}" != "1" ] || [ ! -x "${ONVIF_PTZD}" ]; then
+        return 0
+    fi
+    if pidof ptzd >/dev/null 2>&1; then
+        return 0
+    fi
+
+    "${ONVIF_PTZD}" -c "${CUSTOM_DIR}/configs/ptz.conf" >/dev/null 2>&1 &
+    log "ptzd started (${ONVIF_PTZD})"
+}
+
 ensure_onvif() {
     mount_onvif_ptz_helpers
+    ensure_ptzd
 
     if ps | grep -v grep | grep -q "lighttpd -f /usr/local/etc/lighttpd.conf"; then
         return 0
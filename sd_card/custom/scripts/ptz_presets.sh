@@ -1,12 +1,10 @@
 #!/bin/sh
 
+PTZCTL="/tmp/sd/custom/bin/ptzctl"
 STATE_DIR="/tmp/sd/custom/state"
-PRESETS_DB="${STATE_DIR}/ptz_presets.db"
 POS_FILE="${STATE_DIR}/ptz_position"
 
 mkdir -p "${STATE_DIR}" >/dev/null 2>&1 || true
-[ -f "${PRESETS_DB}" ] || : > "${PRESETS_DB}"
-[ -f "${POS_FILE}" ] || echo "180,98,0" > "${POS_FILE}"
 
 ACTION=""
 NAME=""
@@ -21,30 +19,13 @@ while [ $# -gt 0 ]; do
     esac
 done
 
-next_id() {
-    if [ ! -s "${PRESETS_DB}" ]; then
-        echo "1"
-        return
-    fi
-    awk -F, 'BEGIN{m=0} {if ($1+0>m) m=$1+0} END{print m+1}' "${PRESETS_DB}"
-}
-
 case "$ACTION" in
     add_preset)
         [ -z "${NAME}" ] && NAME="Preset"
-        CUR="$(cat "${POS_FILE}" 2>/dev/null || echo "180,98,0")"
-        X="$(echo "${CUR}" | awk -F, '{print $1}')"
-        Y="$(echo "${CUR}" | awk -F, '{print $2}')"
-        Z="$(echo "${CUR}" | awk -F, '{print $3}')"
-        NID="$(next_id)"
-        echo "${NID},${NAME},${X},${Y},${Z}" >> "${PRESETS_DB}"
-        echo "${NID}"
+        "${PTZCTL}" --preset-save "${NAME}"
         ;;
     del_preset)
-        if [ -n "${ID}" ]; then
-            grep -Ev "^${ID}," "${PRESETS_DB}" > "${PRESETS_DB}.tmp" 2>/dev/null || true
-            mv "${PRESETS_DB}.tmp" "${PRESETS_DB}"
-        fi
+        [ -n "${ID}" ] && "${PTZCTL}" --preset-del "${ID}" >/dev/null 2>&1
         echo "OK"
         ;;
     set_home_position)
@@ -52,7 +33,7 @@ case "$ACTION" in
         echo "OK"
         ;;
     get_presets)
-        cat "${PRESETS_DB}"
+        "${PTZCTL}" --preset-list
         ;;
     *)
         echo ""